@@ -0,0 +1,95 @@
+#include <bits/stdc++.h>
+#include "Benchmark.h"
+#include "../lib/Adaptive.h"
+#include "../lib/BOCC.h"
+#include "../lib/FOCC.h"
+#include "../lib/Keyed.h"
+#include "../lib/O2PL.h"
+#include "../lib/Payloads.h"
+#include "../lib/SS2PL.h"
+using namespace std;
+using sched::ll;
+
+// Builds T over cfg.numItems, runs the benchmark on it and report()s, then
+// prints how long building and destroying T took
+template <typename T, typename Report>
+bool runTimed(const bench::Config& cfg, Report report) {
+    ll setupStart = sched::getCurTime();
+    auto scheduler = make_unique<T>(cfg.numItems);
+    ll setupTime = sched::getCurTime() - setupStart;
+
+    bool ok = bench::runBenchmark(*scheduler, cfg);
+    report(*scheduler);
+
+    ll teardownStart = sched::getCurTime();
+    scheduler.reset();
+    ll teardownTime = sched::getCurTime() - teardownStart;
+
+    printf("Scheduler setup: %.3lf ms, teardown: %.3lf ms\n", setupTime / 1000.0, teardownTime / 1000.0);
+    return ok;
+}
+
+// Runs the benchmark on S, with --sparse-keys on S behind a hash index of
+// sparse keys, or with --payload on S storing records; then report(S&)
+template <typename S, typename Report>
+bool runOn(const bench::Config& cfg, Report report) {
+    if (cfg.sparseKeys && cfg.payloadSize > 0) {
+        printf("--sparse-keys and --payload cannot be combined\n");
+        return false;
+    }
+    if (cfg.sparseKeys) {
+        return runTimed<sched::Keyed<S>>(cfg, [&](auto& keyed) { report(keyed.scheduler()); });
+    }
+    if (cfg.payloadSize > 0) {
+        if constexpr (sched::ValueHook<S>) {
+            return runTimed<sched::Payloads<S>>(cfg, [&](auto& payloads) {
+                payloads.quiesce();
+                payloads.printStats();
+                report(payloads.scheduler());
+            });
+        }
+        else {
+            printf("This scheduler cannot store records\n");
+            return false;
+        }
+    }
+    return runTimed<S>(cfg, report);
+}
+
+// Shared benchmark: runs the BTO-like workload on the scheduler named by the
+// first argument, without the per-scheduler event log
+int main(int argc, char* argv[]) {
+    bench::Config cfg;
+
+    if (argc < 2 || !bench::parseArgs(argc - 1, argv + 1, cfg)) {
+        cout << "Usage: " << argv[0] << " <O2PL|SS2PL|BOCC|FOCC|Adaptive> " << bench::usageArgs() << endl;
+        return 1;
+    }
+
+    string name = argv[1];
+    bool ok;
+    auto noReport = [](auto&) {};
+    auto printStats = [](auto& scheduler) { scheduler.printStats(); };
+
+    if (name == "O2PL") {
+        ok = runOn<sched::O2PL<>>(cfg, noReport);
+    }
+    else if (name == "SS2PL") {
+        ok = runOn<sched::SS2PL<>>(cfg, noReport);
+    }
+    else if (name == "BOCC") {
+        ok = runOn<sched::BOCC<>>(cfg, printStats);
+    }
+    else if (name == "FOCC") {
+        ok = runOn<sched::FOCC_CTA<>>(cfg, printStats);
+    }
+    else if (name == "Adaptive") {
+        ok = runOn<sched::AdaptiveCC>(cfg, printStats);
+    }
+    else {
+        cout << "Unknown scheduler " << name << endl;
+        return 1;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,983 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "../lib/Coro.h"
+#include "../lib/Scheduler.h"
+#include "../lib/WorkStealingPool.h"
+#include "Metrics.h"
+#include "Perf.h"
+
+// Set by the build system, e.g. "Release native LTO"
+#ifndef BUILD_FLAVOR
+#define BUILD_FLAVOR "unknown"
+#endif
+
+namespace bench {
+
+using sched::ll;
+
+struct Config {
+    ll totalTrans, numThreads, numItems, numIters;
+    double writeProbab;
+    bool coroMode = false;
+    std::vector<double> phases; // writeProbab of each equal share of the transactions, if it changes mid-run
+    double skew = 0;       // Zipf exponent of the item choice, 0 for uniform
+    bool adaptive = false; // Adaptive hot-item handling, where the scheduler has it
+    double scanProbab = 0; // Probability that an access scans a range instead of reading one item
+    ll scanLength = 100;   // Items per scan
+    ll validationHelpers = 0; // Helper threads validating large transactions, where the scheduler can use them
+    bool earlyAbort = false; // Abort doomed transactions during their read phase, where the scheduler can tell
+    bool readOnly = false; // Declare transactions that will not write read-only, where the scheduler has a fast path
+    bool preclaim = false; // Take every lock of a transaction before its first access, where the scheduler can
+    ll lockPages = 0; // Items per page of multi-granularity locks, where the scheduler has them; 0 for item locks only
+    ll escalateAfter = 0; // Item locks on a page before escalating to a page lock; 0 for never
+    ll logFlush = 0; // Microseconds per flush of a commit log that commits wait for, where the scheduler has one; 0 for no log
+    bool earlyRelease = false; // Release locks before the commit record is durable
+    ll waitBudget = 0; // Microseconds a transaction may wait in all before it aborts, where the scheduler can tell; 0 for none
+    double stragglerProbab = 0; // Probability that a transaction stalls before its commit
+    ll stragglerDelay = 1000; // Microseconds a straggler stalls
+    ll payloadSize = 0; // Bytes per record, at least 8, where the scheduler stores records; 0 for plain values
+    bool sparseKeys = false; // Address the items by scattered 64-bit keys through a hash index, where the scheduler is keyed
+    bool perf = false; // Hardware counters and per-operation cycle counts
+    MetricsOptions metrics; // Live metrics export
+};
+
+// Parse "<totalTrans> <numThreads> <numItems> <numIters> <writeProbab> [threads|coro] [options]"
+// from argv[1..]; returns false if the arguments do not match
+inline bool parseArgs(int argc, char* argv[], Config& cfg) {
+    if (argc < 6) {
+        return false;
+    }
+
+    cfg.totalTrans = std::stoll(argv[1]);
+    cfg.numThreads = std::stoll(argv[2]);
+    cfg.numItems = std::stoll(argv[3]);
+    cfg.numIters = std::stoll(argv[4]);
+    cfg.writeProbab = std::stod(argv[5]);
+
+    for (int i = 6; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg == "threads" || arg == "coro") {
+            cfg.coroMode = (arg == "coro");
+        }
+        else if (arg == "--perf") {
+            cfg.perf = true;
+        }
+        else if (arg == "--adaptive") {
+            cfg.adaptive = true;
+        }
+        else if (arg == "--early-abort") {
+            cfg.earlyAbort = true;
+        }
+        else if (arg == "--read-only") {
+            cfg.readOnly = true;
+        }
+        else if (arg.rfind("--payload=", 0) == 0) {
+            cfg.payloadSize = std::stoll(arg.substr(arg.find('=') + 1));
+            if (cfg.payloadSize < (ll)sizeof(ll)) {
+                return false;
+            }
+        }
+        else if (arg == "--sparse-keys") {
+            cfg.sparseKeys = true;
+        }
+        else if (arg == "--preclaim") {
+            cfg.preclaim = true;
+        }
+        else if (arg.rfind("--lock-pages=", 0) == 0) {
+            cfg.lockPages = std::stoll(arg.substr(arg.find('=') + 1));
+        }
+        else if (arg.rfind("--escalate-after=", 0) == 0) {
+            cfg.escalateAfter = std::stoll(arg.substr(arg.find('=') + 1));
+        }
+        else if (arg.rfind("--log-flush=", 0) == 0) {
+            cfg.logFlush = std::stoll(arg.substr(arg.find('=') + 1));
+        }
+        else if (arg == "--early-release") {
+            cfg.earlyRelease = true;
+        }
+        else if (arg.rfind("--phases=", 0) == 0) {
+            std::string list = arg.substr(arg.find('=') + 1);
+            for (size_t pos = 0; pos <= list.size();) {
+                size_t comma = std::min(list.find(',', pos), list.size());
+                cfg.phases.push_back(std::stod(list.substr(pos, comma - pos)));
+                pos = comma + 1;
+            }
+        }
+        else if (arg.rfind("--scans=", 0) == 0) {
+            cfg.scanProbab = std::stod(arg.substr(arg.find('=') + 1));
+        }
+        else if (arg.rfind("--scan-length=", 0) == 0) {
+            cfg.scanLength = std::stoll(arg.substr(arg.find('=') + 1));
+        }
+        else if (arg.rfind("--validation-helpers=", 0) == 0) {
+            cfg.validationHelpers = std::stoll(arg.substr(arg.find('=') + 1));
+        }
+        else if (arg.rfind("--wait-budget=", 0) == 0) {
+            cfg.waitBudget = std::stoll(arg.substr(arg.find('=') + 1));
+        }
+        else if (arg.rfind("--stragglers=", 0) == 0) {
+            cfg.stragglerProbab = std::stod(arg.substr(arg.find('=') + 1));
+        }
+        else if (arg.rfind("--straggler-delay=", 0) == 0) {
+            cfg.stragglerDelay = std::stoll(arg.substr(arg.find('=') + 1));
+        }
+        else if (arg.rfind("--skew=", 0) == 0) {
+            cfg.skew = std::stod(arg.substr(arg.find('=') + 1));
+        }
+        else if (arg.rfind("--metrics-file=", 0) == 0) {
+            cfg.metrics.file = arg.substr(arg.find('=') + 1);
+        }
+        else if (arg.rfind("--metrics-socket=", 0) == 0) {
+            cfg.metrics.socket = arg.substr(arg.find('=') + 1);
+        }
+        else if (arg.rfind("--metrics-interval=", 0) == 0) {
+            cfg.metrics.intervalMs = std::stoll(arg.substr(arg.find('=') + 1));
+        }
+        else if (arg.rfind("--metrics-topk=", 0) == 0) {
+            cfg.metrics.topK = std::stoll(arg.substr(arg.find('=') + 1));
+        }
+        else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+inline const char* usageArgs() {
+    return "<totalTrans> <numThreads> <numItems> <numIters> <writeProbab> [threads|coro] [--perf]"
+           " [--phases=P1,P2,...] [--skew=THETA] [--adaptive] [--scans=PROB] [--scan-length=N] [--validation-helpers=N] [--early-abort] [--read-only] [--preclaim] [--lock-pages=N] [--escalate-after=K] [--log-flush=MICROS] [--early-release] [--wait-budget=MICROS] [--stragglers=PROB] [--straggler-delay=MICROS] [--sparse-keys] [--payload=BYTES] [--metrics-file=PATH] [--metrics-socket=PATH] [--metrics-interval=MS] [--metrics-topk=K]";
+}
+
+// BTO-like workload shared by all schedulers.
+//
+// Each transaction reads numIters distinct random items and writes each of
+// them back with probability writeProbab. Accesses are admitted in
+// transaction id order per item: an access that arrives after a younger
+// transaction's conflicting access is skipped. A refused read or write (e.g.
+// an SS2PL lock conflict) is retried until it is granted or must be skipped.
+// With --scans, an access scans the scanLength items starting at the chosen
+// one instead, admitted like a read of each of them. With --read-only, a
+// transaction that draws no write is declared read-only to the scheduler.
+// With --preclaim, a transaction claims the locks of all the items it will
+// read, scan and write before its first access. With --lock-pages, an access
+// refused by a page lock is skipped, as the page's holder may not have
+// accessed the item and the admission order cannot tell that waiting is safe.
+// With --sparse-keys, a keyed scheduler gets item i as a scattered 64-bit key.
+// With --payload, a scheduler that stores records gets records of that size
+// with the value in their first 8 bytes, and a read sums the whole record.
+// With --stragglers, a transaction may stall before its commit while holding
+// its locks.
+template <sched::Scheduler S, typename Instrumentation = NoInstrumentation, typename Metrics = NoMetrics>
+class Benchmark {
+private:
+    using Transaction = typename S::Transaction;
+    using Operation = sched::Operation;
+
+    S& scheduler;
+    const Config& cfg;
+    Instrumentation instr;
+    Metrics metrics;
+
+    std::vector<std::mutex> item_locks;
+    std::vector<ll> maxReadScheduled, maxWriteScheduled;
+    std::atomic<ll> num_item_accessed;
+    std::atomic<ll> num_started; // Transactions begun so far, for the phases
+    std::atomic<ll> num_ops, num_ops_wasted; // Granted accesses, and those of transactions that aborted (threads mode)
+    std::atomic<ll> num_early_aborts;
+    std::atomic<ll> num_timeouts; // Transactions that ran out of wait budget
+    std::vector<std::vector<ll>> latencies; // Microseconds from begin to commit or abort of each transaction, per worker (threads mode)
+    std::vector<std::default_random_engine> rngs; // Random number generator of each worker
+    std::vector<std::string> records; // Record each worker writes in payload mode, the value first
+    std::vector<ll> record_sums; // Sum of the words of the records each worker read in payload mode
+    std::vector<double> zipfCdf; // Item i is chosen with probability proportional to 1 / (i + 1)^skew
+
+    // Key of the item under a keyed scheduler: the item id scattered over the
+    // 64-bit range by an odd multiplier, which keeps the keys distinct
+    static ll keyOf(ll item_id) {
+        if constexpr (sched::KeyValue<S>) {
+            return (ll)((uint64_t)item_id * 0x9e3779b97f4a7c15ULL);
+        }
+        else {
+            return item_id;
+        }
+    }
+
+    // Payload mode: the value is the first 8 bytes of the record, and the
+    // rest is summed so that a read touches the whole record
+    ll useRecord(ll w, std::string_view record) {
+        ll val = 0, sum = 0, word;
+        for (size_t i = 0; i + sizeof(ll) <= record.size(); i += sizeof(ll)) {
+            memcpy(&word, record.data() + i, sizeof(ll));
+            sum += word;
+        }
+        if (record.size() >= sizeof(ll)) {
+            memcpy(&val, record.data(), sizeof(ll));
+        }
+        record_sums[w] += sum;
+        return val;
+    }
+
+    std::string_view fillRecord(ll w, ll val) {
+        memcpy(records[w].data(), &val, sizeof(ll));
+        return records[w];
+    }
+
+    bool readItem(ll w, Transaction* t, ll item_id, ll& locVal) {
+        if constexpr (sched::PayloadScheduler<S>) {
+            std::string_view record;
+            if (!scheduler.read(t, item_id, record)) {
+                return false;
+            }
+            locVal = useRecord(w, record);
+            return true;
+        }
+        else {
+            return scheduler.read(t, keyOf(item_id), locVal);
+        }
+    }
+
+    bool writeItem(ll w, Transaction* t, ll item_id, ll locVal) {
+        if constexpr (sched::PayloadScheduler<S>) {
+            return scheduler.write(t, item_id, fillRecord(w, locVal));
+        }
+        else {
+            return scheduler.write(t, keyOf(item_id), locVal);
+        }
+    }
+
+    // Coroutine mode: in payload mode the read lands in record, to be used
+    // once it resumes
+    auto readItemAsync(Transaction* t, ll item_id, ll& locVal, std::string_view& record) requires sched::AsyncScheduler<S> {
+        if constexpr (sched::PayloadScheduler<S>) {
+            return scheduler.read_async(t, item_id, record);
+        }
+        else {
+            return scheduler.read_async(t, keyOf(item_id), locVal);
+        }
+    }
+
+    auto writeItemAsync(ll w, Transaction* t, ll item_id, ll locVal) requires sched::AsyncScheduler<S> {
+        if constexpr (sched::PayloadScheduler<S>) {
+            return scheduler.write_async(t, item_id, fillRecord(w, locVal));
+        }
+        else {
+            return scheduler.write_async(t, keyOf(item_id), locVal);
+        }
+    }
+
+    bool canRead(ll item_id, ll transId) {
+        // Check if the transaction can read the item
+        if (transId < maxWriteScheduled[item_id]) {
+            return false;
+        }
+        return true;
+    }
+
+    bool canWrite(ll item_id, ll transId) {
+        // Check if the transaction can write to the item
+        if (transId < std::max(maxReadScheduled[item_id], maxWriteScheduled[item_id])) {
+            return false;
+        }
+        return true;
+    }
+
+    // writeProbab of the next transaction to begin
+    double nextWriteProbab() {
+        ll started = num_started++;
+        if (cfg.phases.empty()) {
+            return cfg.writeProbab;
+        }
+        ll phase = started * (ll)cfg.phases.size() / cfg.totalTrans;
+        return cfg.phases[std::min(phase, (ll)cfg.phases.size() - 1)];
+    }
+
+    // Choose numIters distinct random items
+    std::unordered_set<ll> chooseItems(std::default_random_engine& rng) {
+        std::uniform_int_distribution<ll> unifRand_idx(0, cfg.numItems - 1);
+        std::uniform_real_distribution<double> unifRand_real(0, 1);
+
+        std::unordered_set<ll> randIndices;
+        while ((ll)randIndices.size() < cfg.numIters) {
+            if (zipfCdf.empty()) {
+                randIndices.insert(unifRand_idx(rng));
+            }
+            else {
+                ll idx = std::lower_bound(zipfCdf.begin(), zipfCdf.end(), unifRand_real(rng)) - zipfCdf.begin();
+                randIndices.insert(std::min(idx, cfg.numItems - 1));
+            }
+        }
+        return randIndices;
+    }
+
+    // Whether each access of a transaction writes its item back, drawn
+    // before the transaction begins so that it can be declared read-only
+    std::vector<bool> drawWrites(std::default_random_engine& rng) {
+        std::bernoulli_distribution writeDist(nextWriteProbab());
+
+        std::vector<bool> writes(cfg.numIters);
+        for (ll i = 0; i < cfg.numIters; i++) {
+            writes[i] = writeDist(rng);
+        }
+        return writes;
+    }
+
+    // Whether each access of a transaction scans instead, drawn up front like
+    // its writes so that the scanned ranges can be claimed
+    std::vector<bool> drawScans(std::default_random_engine& rng) {
+        std::vector<bool> scans(cfg.numIters, false);
+        if constexpr (sched::ScanScheduler<S>) {
+            std::bernoulli_distribution scanDist(cfg.scanProbab);
+            for (ll i = 0; i < cfg.numIters; i++) {
+                scans[i] = scanDist(rng);
+            }
+        }
+        return scans;
+    }
+
+    // Items a transaction reads (including scanned ranges) and writes, in
+    // the order of its accesses, for a claim
+    std::pair<std::vector<ll>, std::vector<ll>> claimSets(const std::unordered_set<ll>& chosen,
+                                                          const std::vector<bool>& writes,
+                                                          const std::vector<bool>& scans) {
+        std::vector<ll> reads, written;
+        ll access = 0;
+        for (ll item_id : chosen) {
+            if (scans[access]) {
+                for (ll i = item_id; i < std::min(item_id + cfg.scanLength, cfg.numItems); i++) {
+                    reads.push_back(i);
+                }
+            }
+            else {
+                reads.push_back(item_id);
+                if (writes[access]) {
+                    written.push_back(item_id);
+                }
+            }
+            access++;
+        }
+        return {reads, written};
+    }
+
+    Transaction* beginTransaction(const std::vector<bool>& writes) {
+        if constexpr (sched::ReadOnlyHint<S>) {
+            if (cfg.readOnly && std::find(writes.begin(), writes.end(), true) == writes.end()) {
+                return scheduler.beginReadOnly();
+            }
+        }
+        return scheduler.begin();
+    }
+
+    // Whether the scheduler gave up on the transaction's waits
+    bool timedOut(Transaction* t) {
+        if constexpr (sched::WaitBudget<S>) {
+            return scheduler.timedOut(t);
+        }
+        return false;
+    }
+
+    // Whether the commit aborted the transaction after all, following an earlier abort
+    bool cascaded(Transaction* t) {
+        if constexpr (sched::CascadingAbort<S>) {
+            return scheduler.cascaded(t);
+        }
+        return false;
+    }
+
+    // Whether a refused request was refused by a page lock (see --lock-pages)
+    bool refusedByPage(Transaction* t) {
+        if constexpr (sched::MultiGranularity<S>) {
+            return scheduler.refusedByPage(t);
+        }
+        return false;
+    }
+
+    // Whether the transaction has to abort before it finishes its accesses:
+    // it timed out, or the scheduler knows it will fail validation
+    bool mustAbort(Transaction* t) {
+        if constexpr (sched::EarlyAbort<S>) {
+            if (cfg.earlyAbort && scheduler.doomed(t)) {
+                return true;
+            }
+        }
+        return timedOut(t);
+    }
+
+    // Scan the range starting at item from instead of reading it alone;
+    // returns the number of items scanned
+    ll runScan(ll tid, Transaction* t, ll from) requires sched::ScanScheduler<S> {
+        ll to = std::min(from + cfg.scanLength, cfg.numItems);
+        ll waitStart = metrics.now();
+
+        while (true) {
+            // Ascending, so scans do not deadlock on overlapping ranges
+            for (ll i = from; i < to; i++) {
+                item_locks[i].lock();
+            }
+
+            bool allowed = true;
+            for (ll i = from; i < to && allowed; i++) {
+                allowed = canRead(i, t->id);
+            }
+
+            bool granted = false;
+            if (allowed) {
+                // A refused scan may already hold some of its locks (SS2PL),
+                // so the range counts as read from the first attempt
+                for (ll i = from; i < to; i++) {
+                    maxReadScheduled[i] = std::max(maxReadScheduled[i], t->id);
+                }
+
+                ll sum;
+                ll opStart = instr.opStart();
+                granted = scheduler.scan(t, from, to, sum);
+                instr.opEnd(tid, Operation::READ, opStart);
+
+                if (granted) {
+                    num_item_accessed += to - from;
+                }
+            }
+
+            for (ll i = from; i < to; i++) {
+                item_locks[i].unlock();
+            }
+
+            if (!allowed || granted || mustAbort(t) || refusedByPage(t)) {
+                metrics.accessed(tid, from, waitStart, granted);
+                return granted ? to - from : 0;
+            }
+
+            metrics.retried(tid);
+        }
+    }
+
+    bool runTransaction(ll tid) {
+        // Random number generator of the worker running this transaction
+        std::default_random_engine& random_number_generator = rngs[tid];
+
+        std::uniform_int_distribution<ll> unifRand_val(0, 100); // For random value
+
+        std::vector<bool> writes = drawWrites(random_number_generator);
+        std::vector<bool> scans = drawScans(random_number_generator);
+        std::unordered_set<ll> chosen = chooseItems(random_number_generator);
+        ll begun = sched::getCurTime();
+        Transaction* t = beginTransaction(writes);
+        ll ops = 0; // Granted accesses
+        ll access = 0;
+        bool doomed = false;
+
+        if constexpr (sched::PreClaim<S>) {
+            if (cfg.preclaim) {
+                auto [reads, written] = claimSets(chosen, writes, scans);
+                scheduler.claim(t, reads, written);
+            }
+        }
+
+        for (auto& randInd : chosen) {
+            bool scan = scans[access];
+            bool write = writes[access++];
+
+            if (mustAbort(t)) {
+                doomed = true;
+                break;
+            }
+
+            if constexpr (sched::ScanScheduler<S>) {
+                if (scan) {
+                    ops += runScan(tid, t, randInd);
+                    continue;
+                }
+            }
+
+            ll locVal;
+
+            bool flag = true;
+            ll waitStart = metrics.now();
+
+            while (true) {
+                item_locks[randInd].lock();
+
+                if (!canRead(randInd, t->id)) {
+                    flag = false;
+                    item_locks[randInd].unlock();
+                    metrics.accessed(tid, randInd, waitStart, false);
+                    break;
+                }
+
+                ll opStart = instr.opStart();
+                bool granted = readItem(tid, t, randInd, locVal);
+                instr.opEnd(tid, Operation::READ, opStart);
+
+                if (granted) {
+                    num_item_accessed++;
+                    ops++;
+                    // Update maxReadScheduled
+                    maxReadScheduled[randInd] = std::max(maxReadScheduled[randInd], t->id);
+                    item_locks[randInd].unlock();
+                    metrics.accessed(tid, randInd, waitStart, true);
+                    break;
+                }
+
+                item_locks[randInd].unlock();
+
+                if (mustAbort(t) || refusedByPage(t)) {
+                    flag = false;
+                    metrics.accessed(tid, randInd, waitStart, false);
+                    break;
+                }
+                metrics.retried(tid);
+            }
+
+            if (!flag) continue;
+
+            if (write) {
+                // Update the local value
+                locVal += unifRand_val(random_number_generator);
+
+                ll waitStart = metrics.now();
+
+                while (true) {
+                    item_locks[randInd].lock();
+
+                    if (!canWrite(randInd, t->id)) {
+                        item_locks[randInd].unlock();
+                        metrics.accessed(tid, randInd, waitStart, false);
+                        break;
+                    }
+
+                    ll opStart = instr.opStart();
+                    bool granted = writeItem(tid, t, randInd, locVal);
+                    instr.opEnd(tid, Operation::WRITE, opStart);
+
+                    if (granted) {
+                        ops++;
+                        // Update maxWriteScheduled
+                        maxWriteScheduled[randInd] = std::max(maxWriteScheduled[randInd], t->id);
+                        item_locks[randInd].unlock();
+                        metrics.accessed(tid, randInd, waitStart, true);
+                        break;
+                    }
+
+                    item_locks[randInd].unlock();
+
+                    if (mustAbort(t) || refusedByPage(t)) {
+                        metrics.accessed(tid, randInd, waitStart, false);
+                        break;
+                    }
+                    metrics.retried(tid);
+                }
+            }
+        }
+
+        sched::Status status = sched::Status::ABORT;
+
+        if (doomed || mustAbort(t)) {
+            // It would fail validation anyway, or gave up waiting
+            scheduler.abort(t);
+            (timedOut(t) ? num_timeouts : num_early_aborts)++;
+        }
+        else {
+            if (cfg.stragglerProbab > 0 && std::bernoulli_distribution(cfg.stragglerProbab)(random_number_generator)) {
+                std::this_thread::sleep_for(std::chrono::microseconds(cfg.stragglerDelay));
+            }
+
+            // Try to commit the transaction
+            ll opStart = instr.opStart();
+            status = scheduler.commit(t);
+            instr.opEnd(tid, Operation::COMMIT, opStart);
+
+            num_timeouts += timedOut(t);
+        }
+
+        latencies[tid].push_back(sched::getCurTime() - begun);
+
+        num_ops += ops;
+        if (status != sched::Status::COMMIT) {
+            num_ops_wasted += ops;
+        }
+
+        metrics.finished(tid, status == sched::Status::COMMIT);
+
+        delete t;
+
+        return status == sched::Status::COMMIT;
+    }
+
+    // Same transaction as runTransaction, run as a coroutine that suspends
+    // instead of spinning or retrying when an operation has to wait
+    sched::Txn runTransactionAsync() requires sched::AsyncScheduler<S> {
+        using sched::CoroExecutor;
+
+        std::uniform_int_distribution<ll> unifRand_val(0, 100); // For random value
+
+        std::vector<bool> writes = drawWrites(rngs[CoroExecutor::currentWorker()]);
+        std::unordered_set<ll> chosen = chooseItems(rngs[CoroExecutor::currentWorker()]);
+        Transaction* t = beginTransaction(writes);
+        ll access = 0;
+
+        if constexpr (sched::PreClaim<S>) {
+            if (cfg.preclaim) {
+                // This mode has no scans
+                auto [reads, written] = claimSets(chosen, writes, std::vector<bool>(cfg.numIters, false));
+                co_await scheduler.claim_async(t, reads, written);
+            }
+        }
+
+        for (auto& randInd : chosen) {
+            bool write = writes[access++];
+
+            ll locVal;
+            std::string_view record;
+
+            bool flag = true;
+            ll waitStart = metrics.now();
+
+            while (true) {
+                item_locks[randInd].lock();
+
+                if (!canRead(randInd, t->id)) {
+                    flag = false;
+                    item_locks[randInd].unlock();
+                    metrics.accessed(CoroExecutor::currentWorker(), randInd, waitStart, false);
+                    break;
+                }
+
+                // Start the read while holding the item lock, wait for it after releasing
+                ll opStart = instr.opStart();
+                auto op = readItemAsync(t, randInd, locVal, record);
+
+                if (op.granted) {
+                    num_item_accessed++;
+                    // Update maxReadScheduled
+                    maxReadScheduled[randInd] = std::max(maxReadScheduled[randInd], t->id);
+                }
+
+                item_locks[randInd].unlock();
+
+                if (!op.granted && refusedByPage(t)) {
+                    flag = false;
+                    metrics.accessed(CoroExecutor::currentWorker(), randInd, waitStart, false);
+                    break;
+                }
+
+                co_await op.wait;
+                instr.opEnd(CoroExecutor::currentWorker(), Operation::READ, opStart);
+
+                if (op.granted) {
+                    if constexpr (sched::PayloadScheduler<S>) {
+                        locVal = useRecord(CoroExecutor::currentWorker(), record);
+                    }
+                    metrics.accessed(CoroExecutor::currentWorker(), randInd, waitStart, true);
+                    break;
+                }
+
+                metrics.retried(CoroExecutor::currentWorker());
+            }
+
+            if (!flag) continue;
+
+            if (write) {
+                // Update the local value
+                locVal += unifRand_val(rngs[CoroExecutor::currentWorker()]);
+
+                ll waitStart = metrics.now();
+
+                while (true) {
+                    item_locks[randInd].lock();
+
+                    if (!canWrite(randInd, t->id)) {
+                        item_locks[randInd].unlock();
+                        metrics.accessed(CoroExecutor::currentWorker(), randInd, waitStart, false);
+                        break;
+                    }
+
+                    ll opStart = instr.opStart();
+                    auto op = writeItemAsync(CoroExecutor::currentWorker(), t, randInd, locVal);
+
+                    if (op.granted) {
+                        // Update maxWriteScheduled
+                        maxWriteScheduled[randInd] = std::max(maxWriteScheduled[randInd], t->id);
+                    }
+
+                    item_locks[randInd].unlock();
+
+                    if (!op.granted && refusedByPage(t)) {
+                        metrics.accessed(CoroExecutor::currentWorker(), randInd, waitStart, false);
+                        break;
+                    }
+
+                    co_await op.wait;
+                    instr.opEnd(CoroExecutor::currentWorker(), Operation::WRITE, opStart);
+
+                    if (op.granted) {
+                        metrics.accessed(CoroExecutor::currentWorker(), randInd, waitStart, true);
+                        break;
+                    }
+
+                    metrics.retried(CoroExecutor::currentWorker());
+                }
+            }
+        }
+
+        // Try to commit the transaction
+        ll opStart = instr.opStart();
+        co_await scheduler.commit_async(t);
+        instr.opEnd(CoroExecutor::currentWorker(), Operation::COMMIT, opStart);
+
+        bool committed = !cascaded(t);
+        metrics.finished(CoroExecutor::currentWorker(), committed);
+
+        delete t;
+
+        co_return committed;
+    }
+
+public:
+    Benchmark(S& scheduler, const Config& cfg)
+        : scheduler(scheduler), cfg(cfg), instr(cfg.numThreads), metrics(cfg.metrics, cfg.numThreads, cfg.numItems),
+          item_locks(cfg.numItems),
+          maxReadScheduled(cfg.numItems, 0), maxWriteScheduled(cfg.numItems, 0), num_item_accessed(0), num_started(0),
+          num_ops(0), num_ops_wasted(0), num_early_aborts(0), num_timeouts(0), latencies(cfg.numThreads),
+          records(cfg.numThreads, std::string(std::max(cfg.payloadSize, (ll)sizeof(ll)), 'r')), record_sums(cfg.numThreads, 0) {
+        // Initialize the random number generator of each worker with its id and time as seed
+        for (ll i = 0; i < cfg.numThreads; i++) {
+            rngs.push_back(std::default_random_engine(static_cast<unsigned>(i) * static_cast<unsigned>(time(nullptr))));
+        }
+
+        if (cfg.skew > 0) {
+            double sum = 0;
+            for (ll i = 0; i < cfg.numItems; i++) {
+                sum += 1.0 / std::pow((double)(i + 1), cfg.skew);
+                zipfCdf.push_back(sum);
+            }
+            for (auto& c : zipfCdf) {
+                c /= sum;
+            }
+        }
+    }
+
+    // Run the workload and print the results; returns false if the
+    // configuration cannot be run with this scheduler
+    bool run() {
+        if (cfg.coroMode && !sched::AsyncScheduler<S>) {
+            printf("This scheduler does not support the coroutine mode\n");
+            return false;
+        }
+
+        if (cfg.scanProbab > 0 && (cfg.coroMode || !sched::ScanScheduler<S>)) {
+            printf("Scans are only supported in the threads mode of schedulers with range reads\n");
+            return false;
+        }
+
+        if constexpr (sched::Adaptive<S>) {
+            scheduler.setAdaptive(cfg.adaptive);
+        }
+        else if (cfg.adaptive) {
+            printf("This scheduler has no adaptive mode, running without it\n");
+        }
+
+        if constexpr (sched::ParallelValidation<S>) {
+            scheduler.setParallelValidation(cfg.validationHelpers);
+        }
+        else if (cfg.validationHelpers > 0) {
+            printf("This scheduler has no parallel validation, running without it\n");
+        }
+
+        if constexpr (sched::EarlyAbort<S>) {
+            scheduler.setEarlyAbort(cfg.earlyAbort);
+        }
+        else if (cfg.earlyAbort) {
+            printf("This scheduler has no early-abort mode, running without it\n");
+        }
+
+        if (cfg.readOnly && !sched::ReadOnlyHint<S>) {
+            printf("This scheduler has no read-only fast path, running without it\n");
+        }
+
+        if (cfg.sparseKeys && !sched::KeyValue<S>) {
+            printf("This scheduler is not keyed, running on dense item ids\n");
+        }
+
+        if (cfg.payloadSize > 0 && !sched::PayloadScheduler<S>) {
+            printf("This scheduler does not store records, running on plain values\n");
+        }
+
+        if (cfg.preclaim && !sched::PreClaim<S>) {
+            printf("This scheduler has no pre-claiming, running without it\n");
+        }
+
+        if constexpr (sched::MultiGranularity<S>) {
+            scheduler.setLockGranularity(cfg.lockPages, cfg.escalateAfter);
+        }
+        else if (cfg.lockPages > 0) {
+            printf("This scheduler has no page locks, running without them\n");
+        }
+
+        if constexpr (sched::CommitLogging<S>) {
+            scheduler.setCommitLog(cfg.logFlush, cfg.earlyRelease);
+        }
+        else if (cfg.logFlush > 0) {
+            printf("This scheduler has no commit log, running without it\n");
+        }
+
+        if constexpr (sched::WaitBudget<S>) {
+            scheduler.setWaitBudget(cfg.coroMode ? 0 : cfg.waitBudget);
+        }
+        if (cfg.waitBudget > 0 && (cfg.coroMode || !sched::WaitBudget<S>)) {
+            printf("The wait budget applies to the threads mode of schedulers that have one, running without it\n");
+        }
+
+        instr.phaseStart("setup");
+
+        // Transactions start with the usual static split; idle workers steal from busy ones
+        sched::WorkStealingPool<ll> pool(cfg.numThreads);
+        sched::CoroExecutor exec(cfg.numThreads);
+
+        for (ll i = 0; i < cfg.numThreads; i++) {
+            ll numTrans = cfg.totalTrans / cfg.numThreads + (i < cfg.totalTrans % cfg.numThreads);
+            for (ll j = 0; j < numTrans; j++) {
+                if (cfg.coroMode) {
+                    exec.submit(i, j);
+                }
+                else {
+                    pool.submit(i, j);
+                }
+            }
+        }
+
+        instr.phaseEnd();
+
+        auto workerStart = [this](ll w) { instr.workerStart(w); };
+        auto workerExit = [this](ll w) { instr.workerExit(w); };
+
+        metrics.start();
+
+        ll startTime = sched::getCurTime();
+
+        if constexpr (sched::AsyncScheduler<S>) {
+            if (cfg.coroMode) {
+                exec.run([this](ll) {
+                    return runTransactionAsync();
+                }, workerStart, workerExit);
+            }
+        }
+
+        if (!cfg.coroMode) {
+            pool.run([this, &pool](ll tid, ll) {
+                pool.complete(tid, runTransaction(tid));
+            }, workerStart, workerExit);
+        }
+
+        ll endTime = sched::getCurTime();
+
+        metrics.stop();
+
+        double avgCommitDelay = (double)(endTime - startTime) / (double)cfg.totalTrans;
+
+        printf("Build flavor: %s\n", BUILD_FLAVOR);
+
+        printf("Average time taken to commit a transaction: %.3lf microseconds\n", avgCommitDelay);
+
+        double avg_item_accessed = (double)num_item_accessed / (double)cfg.totalTrans;
+        printf("Average number of items accessed per transaction: %.3lf\n", avg_item_accessed);
+        printf("Total number of items accessed: %lld\n", num_item_accessed.load());
+
+        if (cfg.coroMode) {
+            exec.workers().printStats();
+            printf("Maximum transactions in flight: %lld\n", exec.peakInFlight());
+        }
+        else {
+            pool.printStats();
+
+            printf("Wasted work: %lld of %lld granted accesses (%.1lf%%) were in aborted transactions\n", num_ops_wasted.load(),
+                   num_ops.load(), 100.0 * (double)num_ops_wasted / (double)std::max(1LL, num_ops.load()));
+            if (cfg.earlyAbort) {
+                printf("Transactions aborted during their read phase: %lld\n", num_early_aborts.load());
+            }
+            if (sched::WaitBudget<S> && cfg.waitBudget > 0) {
+                printf("Transactions aborted for exceeding the wait budget: %lld\n", num_timeouts.load());
+            }
+
+            std::vector<ll> all;
+            for (auto& own : latencies) {
+                all.insert(all.end(), own.begin(), own.end());
+            }
+            std::sort(all.begin(), all.end());
+            if (!all.empty()) {
+                printf("Transaction latency: p50 %lld, p99 %lld, max %lld microseconds\n", all[all.size() / 2],
+                       all[all.size() * 99 / 100], all.back());
+            }
+        }
+
+        if constexpr (sched::PayloadScheduler<S>) {
+            ll sum = 0;
+            for (ll w : record_sums) {
+                sum += w;
+            }
+            printf("Records of %lld bytes, checksum of the ones read: %lld\n", cfg.payloadSize, sum);
+        }
+
+        if constexpr (sched::MultiGranularity<S>) {
+            if (cfg.lockPages > 0) {
+                printf("Lock escalations: %lld\n", scheduler.escalations());
+            }
+        }
+
+        if constexpr (sched::CommitLogging<S>) {
+            if (const sched::CommitLog* log = scheduler.commitLog()) {
+                printf("Commit log: %lld records in %lld flushes (%.2lf per flush)\n", log->durable(), log->flushes(),
+                       (double)log->durable() / (double)std::max(1LL, log->flushes()));
+            }
+        }
+
+        if constexpr (sched::HotItemAware<S>) {
+            sched::HotItemTracker& hot = scheduler.hotItems();
+            if (hot.isEnabled()) {
+                printf("Hot items: %lld; hottest (sampled accesses):", hot.numHot());
+                for (auto& e : hot.top(5)) {
+                    printf(" %lld (%lld)", e.item, e.count - e.error);
+                }
+                printf("\n");
+            }
+        }
+
+        instr.print();
+
+        return true;
+    }
+};
+
+template <sched::Scheduler S, typename Instrumentation>
+bool runBenchmarkWith(S& scheduler, const Config& cfg) {
+    if (cfg.metrics.enabled()) {
+        return Benchmark<S, Instrumentation, LiveMetrics>(scheduler, cfg).run();
+    }
+    return Benchmark<S, Instrumentation>(scheduler, cfg).run();
+}
+
+template <sched::Scheduler S>
+bool runBenchmark(S& scheduler, const Config& cfg) {
+    if (cfg.perf) {
+        return runBenchmarkWith<S, PerfInstrumentation>(scheduler, cfg);
+    }
+    return runBenchmarkWith<S, NoInstrumentation>(scheduler, cfg);
+}
+
+} // namespace bench
@@ -0,0 +1,90 @@
+#include <bits/stdc++.h>
+#include "Benchmark.h"
+#include "../lib/O2PL.h"
+using namespace std;
+using sched::ll;
+
+// Micro-benchmark of the O2PL commit path on a single hot item: every
+// transaction writes item 0 blindly with probability writeProbab, reads it
+// otherwise, and commits. The threads take their tickets in no particular
+// order, so no transaction both reads and writes: two that did could each
+// wait for the other's read to unlock before their writes. Runs the plain
+// unlock path and the flat-combining one (adaptive mode) back to back.
+template <typename Wait>
+void runMode(const char* name, bool adaptive, ll numThreads, ll transPerThread, double writeProbab) {
+    sched::O2PL<sched::NullLogger, Wait> o2pl(1);
+    o2pl.setAdaptive(adaptive);
+
+    vector<thread> threads;
+    atomic<ll> commitTime(0);
+
+    ll startTime = sched::getCurTime();
+
+    for (ll i = 0; i < numThreads; i++) {
+        threads.emplace_back([&, i]() {
+            default_random_engine rng(static_cast<unsigned>(i + 1));
+            bernoulli_distribution writeDist(writeProbab);
+            ll localCommitTime = 0;
+
+            for (ll j = 0; j < transPerThread; j++) {
+                auto* t = o2pl.begin();
+
+                if (writeDist(rng)) {
+                    o2pl.write(t, 0, j);
+                }
+                else {
+                    ll val = 0;
+                    o2pl.read(t, 0, val);
+                }
+
+                ll commitStart = sched::getCurTime();
+                o2pl.commit(t);
+                localCommitTime += sched::getCurTime() - commitStart;
+
+                delete t;
+            }
+
+            commitTime += localCommitTime;
+        });
+    }
+
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    ll endTime = sched::getCurTime();
+    ll total = numThreads * transPerThread;
+
+    printf("%s: %.0lf transactions per second, average commit %.3lf microseconds, item 0 hot: %s\n", name,
+           (double)total * 1e6 / (double)(endTime - startTime), (double)commitTime / (double)total,
+           o2pl.hotItems().isHot(0) ? "yes" : "no");
+}
+
+template <typename Wait>
+void runModes(ll numThreads, ll transPerThread, double writeProbab) {
+    runMode<Wait>("Plain unlocks", false, numThreads, transPerThread, writeProbab);
+    runMode<Wait>("Flat-combined unlocks", true, numThreads, transPerThread, writeProbab);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        cout << "Usage: " << argv[0] << " <numThreads> <transPerThread> <writeProbab> [spin|yield]" << endl;
+        return 1;
+    }
+
+    ll numThreads = stoll(argv[1]);
+    ll transPerThread = stoll(argv[2]);
+    double writeProbab = stod(argv[3]);
+    string wait = argc > 4 ? argv[4] : "spin";
+
+    printf("Build flavor: %s\n", BUILD_FLAVOR);
+
+    if (wait == "yield") {
+        runModes<sched::YieldWait>(numThreads, transPerThread, writeProbab);
+    }
+    else {
+        runModes<sched::SpinWait>(numThreads, transPerThread, writeProbab);
+    }
+
+    return 0;
+}
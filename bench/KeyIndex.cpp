@@ -0,0 +1,108 @@
+#include <bits/stdc++.h>
+#include "Benchmark.h"
+#include "../lib/KeyIndex.h"
+using namespace std;
+using sched::ll;
+
+// Micro-benchmark of the hash index against the dense item array it replaces
+// under --sparse-keys, against the number of threads. Every thread looks up
+// the same number of random items: as an index into a vector<ll> (the dense
+// baseline), and as a scattered key through find() on a filled index. A
+// separate pass inserts every key from all threads into an empty index, and
+// the run checks that each key got one slot of its own, and that a full
+// index refuses new keys.
+
+ll nanoTime() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+volatile ll sink; // Where the lookups end up, so they are not optimized out
+
+ll keyOf(ll item) {
+    return (ll)((uint64_t)item * 0x9e3779b97f4a7c15ULL);
+}
+
+// Wall time per call and thread of fn(thread, j) for j in [0, perThread)
+template <typename Fn>
+double measure(Fn fn, ll numThreads, ll perThread) {
+    vector<thread> threads;
+
+    ll start = nanoTime();
+    for (ll i = 0; i < numThreads; i++) {
+        threads.emplace_back([&, i]() {
+            for (ll j = 0; j < perThread; j++) {
+                fn(i, j);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    return (double)(nanoTime() - start) / (double)perThread;
+}
+
+int main(int argc, char* argv[]) {
+    ll numItems = argc > 1 ? stoll(argv[1]) : 1000000;
+    ll perThread = argc > 2 ? stoll(argv[2]) : 1000000;
+    ll maxThreads = argc > 3 ? stoll(argv[3]) : 16;
+
+    printf("Build flavor: %s, %lld items, %lld lookups per thread\n", BUILD_FLAVOR, numItems, perThread);
+    printf("%8s %16s %16s %16s\n", "threads", "dense ns", "find ns", "insert ns");
+
+    // Same random items for every pass, so both lookups touch the same working set
+    vector<ll> items(perThread);
+    default_random_engine rng(42);
+    uniform_int_distribution<ll> unif(0, numItems - 1);
+    for (auto& item : items) {
+        item = unif(rng);
+    }
+
+    vector<ll> dense(numItems);
+    sched::KeyIndex index(numItems);
+    for (ll i = 0; i < numItems; i++) {
+        dense[i] = index.insert(keyOf(i));
+    }
+
+    bool ok = true;
+    for (ll numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+        vector<ll> sums(numThreads * 8, 0); // Keeps the loads alive, a cache line per thread
+
+        double denseNs = measure([&](ll i, ll j) { sums[i * 8] += dense[items[j]]; }, numThreads, perThread);
+        double findNs = measure([&](ll i, ll j) { sums[i * 8] += index.find(keyOf(items[j])); }, numThreads, perThread);
+
+        // Every thread inserts all the keys, from a different starting point
+        sched::KeyIndex fresh(numItems);
+        vector<vector<ll>> slots(numThreads, vector<ll>(numItems));
+        double insertNs = measure([&](ll i, ll j) {
+            ll item = (j + i * numItems / numThreads) % numItems;
+            slots[i][item] = fresh.insert(keyOf(item));
+        }, numThreads, numItems);
+
+        printf("%8lld %16.1lf %16.1lf %16.1lf\n", numThreads, denseNs, findNs, insertNs);
+
+        // Same slot for a key on every thread, and no slot shared by two keys
+        vector<ll> first = slots[0];
+        for (ll i = 1; i < numThreads; i++) {
+            ok = ok && slots[i] == first;
+        }
+        sort(first.begin(), first.end());
+        ok = ok && unique(first.begin(), first.end()) == first.end();
+        if (!ok) {
+            printf("Keys got inconsistent slots with %lld threads\n", numThreads);
+        }
+        sink = accumulate(sums.begin(), sums.end(), 0LL);
+    }
+
+    // A full index refuses a new key, and a lookup of it stops after one round
+    sched::KeyIndex full(1);
+    for (ll i = 0; i < full.size(); i++) {
+        full.insert(keyOf(i));
+    }
+    if (full.insert(keyOf(full.size())) != -1 || full.find(keyOf(full.size())) != -1) {
+        printf("A full index took another key\n");
+        ok = false;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,295 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../lib/Common.h"
+
+namespace bench {
+
+using sched::ll;
+
+struct MetricsOptions {
+    std::string file;   // Rewritten with a snapshot every interval
+    std::string socket; // Unix socket answering each connection with a snapshot
+    ll intervalMs = 1000;
+    ll topK = 10;       // Hottest items reported by wait time
+
+    bool enabled() const {
+        return !file.empty() || !socket.empty();
+    }
+};
+
+// Metrics policies of the benchmark. The benchmark reports every finished
+// read, write and transaction through these hooks; NoMetrics compiles them
+// away.
+struct NoMetrics {
+    NoMetrics(const MetricsOptions&, ll, ll) {}
+
+    void start() {}
+    void stop() {}
+
+    ll now() {
+        return 0;
+    }
+
+    void retried(ll) {}
+    void accessed(ll, ll, ll, bool) {}
+    void finished(ll, bool) {}
+};
+
+// Live counters exported in the Prometheus text format while the benchmark
+// runs. Each worker owns its counters and is their only writer, so updates are
+// plain relaxed stores and the exporter reads them without locks.
+class LiveMetrics {
+private:
+    struct alignas(64) WorkerCounters {
+        std::atomic<ll> commits{0}, aborts{0}, retries{0}, ops{0}, waitNanos{0};
+    };
+
+    static void bump(std::atomic<ll>& ctr, ll n = 1) {
+        ctr.store(ctr.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    MetricsOptions opts;
+    std::vector<WorkerCounters> workers;
+    std::vector<std::atomic<ll>> itemWaitNanos; // Shared by the workers
+
+    ll startTime;
+    ll lastOps = 0, lastTime = 0; // For ops/s over the last interval
+    double opsPerSec = 0;
+
+    int listenFd = -1;
+    std::thread exporter;
+    std::mutex stop_mtx;
+    std::condition_variable stop_cv;
+    bool stopping = false;
+
+    static ll nanosNow() {
+        using namespace std::chrono;
+        return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    std::string snapshot() {
+        ll t = nanosNow();
+
+        ll totalOps = 0;
+        for (auto& w : workers) {
+            totalOps += w.ops.load(std::memory_order_relaxed);
+        }
+        if (t > lastTime) {
+            opsPerSec = (double)(totalOps - lastOps) * 1e9 / (double)(t - lastTime);
+        }
+        lastOps = totalOps;
+        lastTime = t;
+
+        std::string out;
+        char line[256];
+
+        auto perWorker = [&](const char* name, const char* type, const char* help, auto value) {
+            snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+            out += line;
+            for (ll w = 0; w < (ll)workers.size(); w++) {
+                snprintf(line, sizeof(line), "%s{worker=\"%lld\"} %s\n", name, w, value(workers[w]).c_str());
+                out += line;
+            }
+        };
+        auto count = [](const std::atomic<ll>& ctr) {
+            return std::to_string(ctr.load(std::memory_order_relaxed));
+        };
+        auto seconds = [](ll nanos) {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%.9f", (double)nanos / 1e9);
+            return std::string(buf);
+        };
+
+        perWorker("sched_commits_total", "counter", "Committed transactions.",
+                  [&](WorkerCounters& w) { return count(w.commits); });
+        perWorker("sched_aborts_total", "counter", "Aborted transactions.",
+                  [&](WorkerCounters& w) { return count(w.aborts); });
+        perWorker("sched_retries_total", "counter", "Reads and writes refused by the scheduler and tried again.",
+                  [&](WorkerCounters& w) { return count(w.retries); });
+        perWorker("sched_ops_total", "counter", "Granted reads and writes.",
+                  [&](WorkerCounters& w) { return count(w.ops); });
+        perWorker("sched_wait_seconds_total", "counter", "Time from read and write requests to their grant or skip.",
+                  [&](WorkerCounters& w) { return seconds(w.waitNanos.load(std::memory_order_relaxed)); });
+
+        snprintf(line, sizeof(line),
+                 "# HELP sched_ops_per_second Granted reads and writes per second over the last interval.\n"
+                 "# TYPE sched_ops_per_second gauge\nsched_ops_per_second %.3f\n", opsPerSec);
+        out += line;
+        snprintf(line, sizeof(line),
+                 "# HELP sched_uptime_seconds Time since the workers started.\n"
+                 "# TYPE sched_uptime_seconds gauge\nsched_uptime_seconds %s\n", seconds(t - startTime).c_str());
+        out += line;
+
+        // Contention heat map: the topK items with the largest wait time
+        std::vector<std::pair<ll, ll>> hot; // {waitNanos, item}
+        for (ll i = 0; i < (ll)itemWaitNanos.size(); i++) {
+            ll nanos = itemWaitNanos[i].load(std::memory_order_relaxed);
+            if (nanos > 0) {
+                hot.push_back({nanos, i});
+            }
+        }
+        ll k = std::min((ll)hot.size(), opts.topK);
+        std::partial_sort(hot.begin(), hot.begin() + k, hot.end(), std::greater<>());
+
+        out += "# HELP sched_item_wait_seconds_total Wait time of the hottest items.\n"
+               "# TYPE sched_item_wait_seconds_total counter\n";
+        for (ll r = 0; r < k; r++) {
+            snprintf(line, sizeof(line), "sched_item_wait_seconds_total{item=\"%lld\",rank=\"%lld\"} %s\n",
+                     hot[r].second, r + 1, seconds(hot[r].first).c_str());
+            out += line;
+        }
+
+        return out;
+    }
+
+    // Replace the file atomically, so a scraper never sees half a snapshot
+    void writeFile(const std::string& text) {
+        std::string tmp = opts.file + ".tmp";
+        FILE* f = fopen(tmp.c_str(), "w");
+        if (!f) {
+            return;
+        }
+        fwrite(text.data(), 1, text.size(), f);
+        fclose(f);
+        rename(tmp.c_str(), opts.file.c_str());
+    }
+
+    void openSocket() {
+        sockaddr_un addr{};
+        if (opts.socket.size() >= sizeof(addr.sun_path)) {
+            fprintf(stderr, "Metrics socket path too long: %s\n", opts.socket.c_str());
+            return;
+        }
+
+        listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        addr.sun_family = AF_UNIX;
+        opts.socket.copy(addr.sun_path, opts.socket.size());
+        unlink(opts.socket.c_str());
+
+        if (listenFd < 0 || bind(listenFd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, 8) < 0) {
+            perror("Metrics socket");
+            if (listenFd >= 0) {
+                close(listenFd);
+            }
+            listenFd = -1;
+        }
+    }
+
+    // Answer every pending connection with a fresh snapshot
+    void serveSocket(ll timeoutMs) {
+        pollfd pfd{listenFd, POLLIN, 0};
+        while (poll(&pfd, 1, (int)timeoutMs) > 0) {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd >= 0) {
+                std::string text = snapshot();
+                for (size_t sent = 0; sent < text.size();) {
+                    ssize_t n = send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+                    if (n <= 0) {
+                        break;
+                    }
+                    sent += n;
+                }
+                close(fd);
+            }
+            timeoutMs = 0;
+        }
+    }
+
+    void exportLoop() {
+        std::unique_lock<std::mutex> lk(stop_mtx);
+        while (!stopping) {
+            if (listenFd >= 0) {
+                // Wait for scrapers instead of sleeping
+                lk.unlock();
+                serveSocket(opts.intervalMs);
+                lk.lock();
+            }
+            else {
+                stop_cv.wait_for(lk, std::chrono::milliseconds(opts.intervalMs));
+            }
+
+            if (!opts.file.empty()) {
+                writeFile(snapshot());
+            }
+        }
+    }
+
+public:
+    LiveMetrics(const MetricsOptions& opts, ll numWorkers, ll numItems)
+        : opts(opts), workers(numWorkers), itemWaitNanos(numItems), startTime(nanosNow()) {}
+
+    ~LiveMetrics() {
+        stop();
+    }
+
+    void start() {
+        startTime = lastTime = nanosNow();
+        if (!opts.socket.empty()) {
+            openSocket();
+        }
+        exporter = std::thread(&LiveMetrics::exportLoop, this);
+    }
+
+    // Export the final totals and shut the endpoint down
+    void stop() {
+        if (!exporter.joinable()) {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lk(stop_mtx);
+            stopping = true;
+        }
+        stop_cv.notify_all();
+        exporter.join();
+
+        if (!opts.file.empty()) {
+            writeFile(snapshot());
+        }
+        if (listenFd >= 0) {
+            close(listenFd);
+            unlink(opts.socket.c_str());
+            listenFd = -1;
+        }
+    }
+
+    ll now() {
+        return nanosNow();
+    }
+
+    void retried(ll worker) {
+        bump(workers[worker].retries);
+    }
+
+    // A read or write requested at start is over: granted, or skipped by the driver
+    void accessed(ll worker, ll item, ll start, bool granted) {
+        ll waited = nanosNow() - start;
+
+        if (granted) {
+            bump(workers[worker].ops);
+        }
+        bump(workers[worker].waitNanos, waited);
+        itemWaitNanos[item].fetch_add(waited, std::memory_order_relaxed);
+    }
+
+    void finished(ll worker, bool committed) {
+        bump(committed ? workers[worker].commits : workers[worker].aborts);
+    }
+};
+
+} // namespace bench
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "../lib/Common.h"
+
+namespace bench {
+
+using sched::ll;
+
+// Hardware and software counters of the calling thread, read with
+// perf_event_open. Events the kernel or CPU does not provide are reported
+// as n/a instead of failing the run.
+class PerfCounters {
+public:
+    enum Event {
+        CYCLES,
+        INSTRUCTIONS,
+        LLC_MISSES,
+        HITM,          // Loads served by a modified line in another core's cache (Intel only)
+        TASK_CLOCK,    // Nanoseconds on CPU
+        CONTEXT_SWITCHES,
+        NUM_EVENTS
+    };
+
+    struct Values {
+        ll value[NUM_EVENTS];
+        bool valid[NUM_EVENTS];
+
+        Values() {
+            for (int e = 0; e < NUM_EVENTS; e++) {
+                value[e] = 0;
+                valid[e] = false;
+            }
+        }
+
+        void add(const Values& other) {
+            for (int e = 0; e < NUM_EVENTS; e++) {
+                if (other.valid[e]) {
+                    value[e] += other.value[e];
+                    valid[e] = true;
+                }
+            }
+        }
+    };
+
+private:
+    int fds[NUM_EVENTS];
+
+    static bool isIntel() {
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        std::string line;
+        while (std::getline(cpuinfo, line)) {
+            if (line.rfind("vendor_id", 0) == 0) {
+                return line.find("GenuineIntel") != std::string::npos;
+            }
+        }
+        return false;
+    }
+
+    static int open(ll type, ll config, bool excludeKernel = true) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = excludeKernel;
+        attr.exclude_hv = 1;
+        return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    // Software events such as context switches happen in the kernel, so
+    // count kernel time where perf_event_paranoid allows it
+    static int openSoftware(ll config) {
+        int fd = open(PERF_TYPE_SOFTWARE, config, false);
+        return fd >= 0 ? fd : open(PERF_TYPE_SOFTWARE, config);
+    }
+
+public:
+    PerfCounters() {
+        static const bool intel = isIntel();
+
+        fds[CYCLES] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        fds[INSTRUCTIONS] = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        fds[LLC_MISSES] = open(PERF_TYPE_HW_CACHE,
+                               PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        // MEM_LOAD_L3_HIT_RETIRED.XSNP_HITM (XSNP_FWD on newer cores): event 0xd2, umask 0x04
+        fds[HITM] = intel ? open(PERF_TYPE_RAW, 0x04d2) : -1;
+        fds[TASK_CLOCK] = openSoftware(PERF_COUNT_SW_TASK_CLOCK);
+        fds[CONTEXT_SWITCHES] = openSoftware(PERF_COUNT_SW_CONTEXT_SWITCHES);
+    }
+
+    ~PerfCounters() {
+        for (int e = 0; e < NUM_EVENTS; e++) {
+            if (fds[e] >= 0) {
+                close(fds[e]);
+            }
+        }
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    void start() {
+        for (int e = 0; e < NUM_EVENTS; e++) {
+            if (fds[e] >= 0) {
+                ioctl(fds[e], PERF_EVENT_IOC_RESET, 0);
+                ioctl(fds[e], PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+    }
+
+    Values stop() {
+        Values v;
+        for (int e = 0; e < NUM_EVENTS; e++) {
+            if (fds[e] >= 0) {
+                ioctl(fds[e], PERF_EVENT_IOC_DISABLE, 0);
+                long long count;
+                if (read(fds[e], &count, sizeof(count)) == sizeof(count)) {
+                    v.value[e] = count;
+                    v.valid[e] = true;
+                }
+            }
+        }
+        return v;
+    }
+
+    static void print(const char* label, const Values& v) {
+        static const char* names[NUM_EVENTS] = {"cycles", "instructions", "LLC misses", "HITM", "task clock (ns)", "context switches"};
+
+        printf("%s:", label);
+        for (int e = 0; e < NUM_EVENTS; e++) {
+            if (v.valid[e]) {
+                printf(" %s %lld,", names[e], v.value[e]);
+            }
+            else {
+                printf(" %s n/a,", names[e]);
+            }
+        }
+        if (v.valid[CYCLES] && v.valid[INSTRUCTIONS] && v.value[CYCLES] > 0) {
+            printf(" IPC %.3lf", (double)v.value[INSTRUCTIONS] / (double)v.value[CYCLES]);
+        }
+        else {
+            printf(" IPC n/a");
+        }
+        printf("\n");
+    }
+};
+
+inline ll readCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Instrumentation policies of the benchmark. The benchmark brackets every
+// phase, every worker's lifetime and every scheduler call with these hooks;
+// NoInstrumentation compiles them away.
+struct NoInstrumentation {
+    NoInstrumentation(ll) {}
+
+    void phaseStart(const char*) {}
+    void phaseEnd() {}
+    void workerStart(ll) {}
+    void workerExit(ll) {}
+
+    ll opStart() {
+        return 0;
+    }
+
+    void opEnd(ll, sched::Operation, ll) {}
+
+    void print() const {}
+};
+
+// perf_event_open counters per phase and per worker, plus rdtsc cycles per
+// read, write and commit call
+class PerfInstrumentation {
+private:
+    struct alignas(64) WorkerData {
+        PerfCounters::Values counters;
+        ll opCycles[3] = {0, 0, 0};
+        ll opCount[3] = {0, 0, 0};
+    };
+
+    std::vector<WorkerData> workers;
+    std::vector<PerfCounters*> workerCounters;
+
+    // Phases run on the main thread
+    PerfCounters* phaseCounters = nullptr;
+    const char* phaseName = nullptr;
+    std::vector<std::pair<const char*, PerfCounters::Values>> phases;
+
+public:
+    PerfInstrumentation(ll numWorkers) : workers(numWorkers), workerCounters(numWorkers, nullptr) {}
+
+    ~PerfInstrumentation() {
+        delete phaseCounters;
+    }
+
+    void phaseStart(const char* name) {
+        phaseName = name;
+        if (!phaseCounters) {
+            phaseCounters = new PerfCounters();
+        }
+        phaseCounters->start();
+    }
+
+    void phaseEnd() {
+        phases.push_back({phaseName, phaseCounters->stop()});
+    }
+
+    void workerStart(ll worker) {
+        workerCounters[worker] = new PerfCounters();
+        workerCounters[worker]->start();
+    }
+
+    void workerExit(ll worker) {
+        workers[worker].counters = workerCounters[worker]->stop();
+        delete workerCounters[worker];
+        workerCounters[worker] = nullptr;
+    }
+
+    ll opStart() {
+        return readCycles();
+    }
+
+    void opEnd(ll worker, sched::Operation op, ll start) {
+        workers[worker].opCycles[(int)op] += readCycles() - start;
+        workers[worker].opCount[(int)op]++;
+    }
+
+    void print() const {
+        for (auto& [name, values] : phases) {
+            PerfCounters::print((std::string("Phase ") + name + " (main thread)").c_str(), values);
+        }
+
+        PerfCounters::Values total;
+        ll opCycles[3] = {0, 0, 0}, opCount[3] = {0, 0, 0};
+
+        for (ll w = 0; w < (ll)workers.size(); w++) {
+            PerfCounters::print(("Phase execute, worker " + std::to_string(w)).c_str(), workers[w].counters);
+            total.add(workers[w].counters);
+            for (int op = 0; op < 3; op++) {
+                opCycles[op] += workers[w].opCycles[op];
+                opCount[op] += workers[w].opCount[op];
+            }
+        }
+        PerfCounters::print("Phase execute, all workers", total);
+
+        static const char* names[3] = {"read", "write", "commit"};
+        printf("Cycles per operation:");
+        for (int op = 0; op < 3; op++) {
+            printf(" %s %.1lf (%lld calls)%s", names[op],
+                   opCount[op] ? (double)opCycles[op] / (double)opCount[op] : 0.0, opCount[op], op < 2 ? "," : "\n");
+        }
+    }
+};
+
+} // namespace bench
@@ -0,0 +1,82 @@
+#include <bits/stdc++.h>
+#include "Benchmark.h"
+#include "../lib/Timestamps.h"
+using namespace std;
+using sched::ll;
+
+// Micro-benchmark of timestamp allocation against the number of threads: the
+// wall clock BOCC used before, and the commit (next) and start (now)
+// timestamps of the logical clock. Every thread takes the same number of
+// timestamps; the run also counts the ties among them and checks that the
+// commit timestamps are unique and that every thread sees them increase.
+
+ll nanoTime() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct Result {
+    double nsPerCall; // Wall time of the run per timestamp and thread
+    ll ties; // Timestamps taken more than once
+    bool ordered; // Strictly increasing on every thread
+};
+
+template <typename Source>
+Result measure(Source source, ll numThreads, ll perThread) {
+    vector<vector<ll>> taken(numThreads, vector<ll>(perThread));
+    vector<thread> threads;
+
+    ll start = nanoTime();
+    for (ll i = 0; i < numThreads; i++) {
+        threads.emplace_back([&, i]() {
+            for (ll j = 0; j < perThread; j++) {
+                taken[i][j] = source();
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    ll elapsed = nanoTime() - start;
+
+    Result result = {(double)elapsed / (double)perThread, 0, true};
+    vector<ll> all;
+    for (auto& own : taken) {
+        for (ll j = 1; j < perThread; j++) {
+            result.ordered = result.ordered && own[j] > own[j - 1];
+        }
+        all.insert(all.end(), own.begin(), own.end());
+    }
+    sort(all.begin(), all.end());
+    result.ties = all.size() - (unique(all.begin(), all.end()) - all.begin());
+
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    ll perThread = argc > 1 ? stoll(argv[1]) : 100000;
+    ll maxThreads = argc > 2 ? stoll(argv[2]) : 64;
+
+    printf("Build flavor: %s, %lld timestamps per thread\n", BUILD_FLAVOR, perThread);
+    printf("%8s %16s %16s %16s %12s\n", "threads", "wall clock ns", "commit ts ns", "start ts ns", "clock ties");
+
+    bool ok = true;
+    for (ll numThreads = 1; numThreads <= maxThreads; numThreads *= 2) {
+        sched::TimestampOracle oracle;
+
+        Result wall = measure([]() { return sched::getCurTime(); }, numThreads, perThread);
+        Result commit = measure([&]() { return oracle.next(); }, numThreads, perThread);
+        Result start = measure([&]() { return oracle.now(); }, numThreads, perThread);
+
+        printf("%8lld %16.1lf %16.1lf %16.1lf %12lld\n", numThreads, wall.nsPerCall, commit.nsPerCall,
+               start.nsPerCall, wall.ties);
+
+        // Commit timestamps never tie, and a start taken after them is not older
+        if (commit.ties != 0 || !commit.ordered || oracle.now() != numThreads * perThread) {
+            printf("Commit timestamps tied or went backwards with %lld threads\n", numThreads);
+            ok = false;
+        }
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+#include <bits/stdc++.h>
+#include "Benchmark.h"
+#include "../lib/BOCC.h"
+#include "../lib/FOCC.h"
+#include "../lib/Simd.h"
+using namespace std;
+using sched::ll;
+
+// Micro-benchmark of OCC validation cost against the size of the validated
+// set: the maxGather kernel against its scalar loop, and whole BOCC commits
+// of read-only transactions and FOCC commits of write-only ones, which
+// validate their read and write sets. Single-threaded, so nothing conflicts
+// and every commit succeeds.
+
+const ll numItems = 100000;
+
+ll nanoTime() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+vector<ll> randomItems(ll n, default_random_engine& rng) {
+    vector<ll> items(numItems);
+    iota(items.begin(), items.end(), 0);
+    shuffle(items.begin(), items.end(), rng);
+    items.resize(n);
+    return items;
+}
+
+// Nanoseconds per call of kernel over n random indices
+template <typename Kernel>
+double kernelTime(Kernel kernel, const vector<ll>& vals, const vector<ll>& idx, ll repeats) {
+    volatile ll sink = 0;
+    ll start = nanoTime();
+    for (ll r = 0; r < repeats; r++) {
+        sink = sink + kernel(vals.data(), idx.data(), (ll)idx.size(), -1);
+    }
+    return (double)(nanoTime() - start) / (double)repeats;
+}
+
+// Nanoseconds per commit of transactions that read (BOCC) or write (FOCC) the items
+template <typename S>
+double commitTime(const vector<ll>& items, bool writes, ll repeats) {
+    S scheduler(numItems);
+    ll total = 0;
+
+    for (ll r = 0; r < repeats; r++) {
+        auto* t = scheduler.begin();
+        for (ll item : items) {
+            ll val;
+            if (writes) {
+                scheduler.write(t, item, r);
+            }
+            else {
+                scheduler.read(t, item, val);
+            }
+        }
+
+        ll start = nanoTime();
+        scheduler.commit(t);
+        total += nanoTime() - start;
+
+        delete t;
+    }
+
+    return (double)total / (double)repeats;
+}
+
+int main(int argc, char* argv[]) {
+    ll repeats = argc > 1 ? stoll(argv[1]) : 200;
+
+    printf("Build flavor: %s, validation kernel: %s\n", BUILD_FLAVOR, sched::simdKernel());
+
+    default_random_engine rng(1);
+    vector<ll> vals(numItems);
+    for (auto& v : vals) {
+        v = rng() % 1000000;
+    }
+
+    printf("%8s %14s %14s %14s %14s\n", "set size", "kernel ns", "scalar ns", "BOCC commit ns", "FOCC commit ns");
+
+    for (ll n : {10, 100, 1000, 10000}) {
+        vector<ll> items = randomItems(n, rng);
+        ll kernelRepeats = repeats * 100000 / n;
+
+        double kernel = kernelTime(sched::maxGather, vals, items, kernelRepeats);
+        double scalar = kernelTime(sched::maxGatherScalar, vals, items, kernelRepeats);
+        double bocc = commitTime<sched::BOCC<>>(items, false, repeats);
+        double focc = commitTime<sched::FOCC_CTA<>>(items, true, repeats);
+
+        printf("%8lld %14.1lf %14.1lf %14.1lf %14.1lf\n", n, kernel, scalar, bocc, focc);
+    }
+
+    return 0;
+}
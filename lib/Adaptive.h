@@ -0,0 +1,272 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+#include "BOCC.h"
+#include "Common.h"
+#include "O2PL.h"
+
+namespace sched {
+
+namespace adaptive {
+
+enum class Mode {
+    LOCKING,   // O2PL
+    OPTIMISTIC // BOCC
+};
+
+class Transaction {
+public:
+    ll id;
+    Mode mode;
+    o2pl::Transaction* locking = nullptr;
+    bocc::Transaction* optimistic = nullptr;
+
+    // Reported to the policy when the transaction ends
+    ll reads = 0, writes = 0, waitTime = 0; // waitTime in nanoseconds
+
+    Transaction(ll id, Mode mode) : id(id), mode(mode) {}
+
+    ~Transaction() {
+        delete locking;
+        delete optimistic;
+    }
+};
+
+// When to switch. The decision is taken once per window of finished
+// transactions, and a new mode is kept for at least minWindows windows.
+struct Policy {
+    ll window = 500;
+    ll minWindows = 4;
+    double maxAbortRate = 0.1;  // Optimistic -> locking above this abort rate
+    double minWriteShare = 0.1; // Locking -> optimistic below this share of writes among accesses
+    double maxWaitRatio = 2;    // Locking -> optimistic above this many times BOCC's time per commit when last left
+};
+
+} // namespace adaptive
+
+// Adaptive concurrency control: runs every transaction under O2PL or BOCC and
+// switches between them as the workload changes.
+//
+// Each window of finished transactions reports its abort rate, the share of
+// writes among its accesses and the time its transactions spent in reads,
+// writes and commits, waiting included, per committed transaction. Under
+// BOCC, a high abort rate switches to O2PL, and the window's time per commit,
+// which counts the work lost to aborts, is remembered. Under O2PL, a write
+// share below both minWriteShare and half the share seen when BOCC was last
+// left switches back, so the engine does not bounce between the two; so does
+// contention that makes a commit wait more than maxWaitRatio times BOCC's
+// remembered time per commit. The times are also kept per protocol for
+// printStats().
+//
+// A switch happens at a quiescent point: begin() holds new transactions back,
+// the active ones finish, and the item values move to the other scheduler.
+// Transactions block in begin() while that happens, so there is no coroutine
+// mode.
+class AdaptiveCC {
+public:
+    using Transaction = adaptive::Transaction;
+    using Mode = adaptive::Mode;
+
+private:
+    ll size;
+    O2PL<> locking;
+    BOCC<> optimistic;
+    adaptive::Policy policy;
+
+    std::atomic<Mode> mode;
+    std::atomic<ll> trans_id_ctr;
+    std::atomic<ll> active;
+    std::atomic<bool> switching;
+
+    // Current window. finished only grows; the transaction that brings it to
+    // a multiple of the window closes one, taking the other counts with an
+    // exchange, so none is lost to a concurrent finish.
+    std::atomic<ll> finished, aborted, reads, writes, waited;
+
+    std::mutex policy_mtx; // Guards the fields below and the switches
+    ll windowsInMode = 0;
+    double optimisticExitShare = 1; // Write share when BOCC was last left
+    double optimisticExitWait = 0;  // Nanoseconds per commit when BOCC was last left, 0 before
+
+    // Totals per mode, for printStats()
+    std::atomic<ll> switches;
+    std::atomic<ll> transInMode[2], accessesInMode[2], waitInMode[2];
+
+    static ll nanoTime() {
+        using namespace std::chrono;
+        return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Under policy_mtx
+    void switchTo(Mode next) {
+        // Hold new transactions back and let the active ones finish
+        switching = true;
+        while (active > 0) {
+            std::this_thread::yield();
+        }
+
+        for (ll i = 0; i < size; i++) {
+            if (next == Mode::LOCKING) {
+                locking.setValue(i, optimistic.value(i));
+            }
+            else {
+                optimistic.setValue(i, locking.value(i));
+            }
+        }
+
+        mode = next;
+        switches++;
+        windowsInMode = 0;
+        switching = false;
+    }
+
+    // Report a finished transaction; the one that closes a window decides
+    void finish(Transaction* t, bool committed) {
+        reads += t->reads;
+        writes += t->writes;
+        waited += t->waitTime;
+        if (!committed) {
+            aborted++;
+        }
+        transInMode[(int)t->mode]++;
+        accessesInMode[(int)t->mode] += t->reads + t->writes;
+        waitInMode[(int)t->mode] += t->waitTime;
+
+        // Leave the quiescent count before a possible switch waits for it
+        active--;
+
+        if ((finished.fetch_add(1) + 1) % policy.window != 0) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> guard(policy_mtx);
+
+        ll numAborted = std::min(aborted.exchange(0), policy.window);
+        ll numReads = reads.exchange(0), numWrites = writes.exchange(0);
+        ll numWaited = waited.exchange(0);
+
+        double abortRate = (double)numAborted / (double)policy.window;
+        double writeShare = numReads + numWrites ? (double)numWrites / (double)(numReads + numWrites) : 0;
+        double waitPerCommit = (double)numWaited / (double)std::max(1LL, policy.window - numAborted);
+
+        if (++windowsInMode < policy.minWindows) {
+            return;
+        }
+
+        if (mode == Mode::OPTIMISTIC && abortRate > policy.maxAbortRate) {
+            optimisticExitShare = writeShare;
+            optimisticExitWait = waitPerCommit;
+            switchTo(Mode::LOCKING);
+        }
+        else if (mode == Mode::LOCKING &&
+                 ((writeShare < policy.minWriteShare && writeShare < optimisticExitShare / 2) ||
+                  (optimisticExitWait > 0 && waitPerCommit > policy.maxWaitRatio * optimisticExitWait))) {
+            switchTo(Mode::OPTIMISTIC);
+        }
+    }
+
+public:
+    AdaptiveCC(ll m, const adaptive::Policy& policy = adaptive::Policy())
+        : size(m), locking(m), optimistic(m), policy(policy), mode(Mode::LOCKING), trans_id_ctr(1), active(0),
+          switching(false), finished(0), aborted(0), reads(0), writes(0), waited(0), switches(0) {
+        for (int i = 0; i < 2; i++) {
+            transInMode[i] = 0;
+            accessesInMode[i] = 0;
+            waitInMode[i] = 0;
+        }
+    }
+
+    Transaction* begin() {
+        while (true) {
+            while (switching) {
+                std::this_thread::yield();
+            }
+
+            active++;
+            if (!switching) {
+                break;
+            }
+            active--;
+        }
+
+        // Ids increase across switches, unlike those of the inner schedulers
+        Transaction* t = new Transaction(trans_id_ctr.fetch_add(1), mode);
+        if (t->mode == Mode::LOCKING) {
+            t->locking = locking.begin();
+        }
+        else {
+            t->optimistic = optimistic.begin();
+        }
+        return t;
+    }
+
+    bool read(Transaction* t, ll item_id, ll& locVal) {
+        ll start = nanoTime();
+        bool granted = t->mode == Mode::LOCKING ? locking.read(t->locking, item_id, locVal)
+                                                : optimistic.read(t->optimistic, item_id, locVal);
+        t->waitTime += nanoTime() - start;
+        t->reads += granted;
+        return granted;
+    }
+
+    bool write(Transaction* t, ll item_id, ll newVal) {
+        ll start = nanoTime();
+        bool granted = t->mode == Mode::LOCKING ? locking.write(t->locking, item_id, newVal)
+                                                : optimistic.write(t->optimistic, item_id, newVal);
+        t->waitTime += nanoTime() - start;
+        t->writes += granted;
+        return granted;
+    }
+
+    bool scan(Transaction* t, ll from, ll to, ll& sum) {
+        ll start = nanoTime();
+        bool granted = t->mode == Mode::LOCKING ? locking.scan(t->locking, from, to, sum)
+                                                : optimistic.scan(t->optimistic, from, to, sum);
+        t->waitTime += nanoTime() - start;
+        t->reads += granted ? to - from : 0;
+        return granted;
+    }
+
+    Status commit(Transaction* t) {
+        ll start = nanoTime();
+        Status status = t->mode == Mode::LOCKING ? locking.commit(t->locking) : optimistic.commit(t->optimistic);
+        t->waitTime += nanoTime() - start;
+
+        finish(t, status == Status::COMMIT);
+        return status;
+    }
+
+    void abort(Transaction* t) {
+        if (t->mode == Mode::LOCKING) {
+            locking.abort(t->locking);
+        }
+        else {
+            optimistic.abort(t->optimistic);
+        }
+
+        finish(t, false);
+    }
+
+    Mode currentMode() const {
+        return mode;
+    }
+
+    void printStats() const {
+        printf("Protocol switches: %lld, final protocol: %s\n", switches.load(), mode == Mode::LOCKING ? "O2PL" : "BOCC");
+
+        const char* names[2] = {"O2PL", "BOCC"};
+        for (int i = 0; i < 2; i++) {
+            ll accesses = accessesInMode[i];
+            printf("Under %s: %lld transactions, %.3lf microseconds per read, write or commit\n", names[i],
+                   transInMode[i].load(), (double)waitInMode[i] / 1e3 / (double)std::max(1LL, accesses + transInMode[i]));
+        }
+    }
+};
+
+} // namespace sched
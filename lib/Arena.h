@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include "Common.h"
+
+namespace sched {
+
+// Record buffer: a header followed by size bytes of data. stored and gen are
+// kept up to date by Payloads (see Payloads.h); gen is never reset, so it
+// stays unique across reuses of the memory.
+struct Record {
+    std::atomic<ll> stored{0}; // Times stored in an item minus times replaced there
+    std::atomic<ll> gen{0}; // Bumped each time the record is retired
+    ll size = 0;
+    ll sizeClass = 0; // -1 if allocated outside the slabs
+
+    char* data() {
+        return reinterpret_cast<char*>(this + 1);
+    }
+};
+
+// Slab allocator of records.
+//
+// Records up to MAX_RECORD bytes, header included, come from size classes of
+// powers of two from MIN_RECORD up. Each class carves slabs of SLAB_BYTES into
+// records and keeps freed records in a free list under its own mutex, so
+// records of one size are packed together and their memory is reused without
+// going back to malloc. Larger records are allocated on their own. Slabs are
+// only returned when the arena is destroyed, with any records left in them.
+class SlabArena {
+public:
+    static constexpr ll MIN_RECORD = 64;
+    static constexpr ll MAX_RECORD = 64 * 1024;
+    static constexpr ll SLAB_BYTES = 1 << 20;
+
+private:
+    static constexpr ll NUM_CLASSES = std::countr_zero((uint64_t)(MAX_RECORD / MIN_RECORD)) + 1;
+
+    struct SizeClass {
+        std::mutex mtx;
+        std::vector<Record*> free;
+        char* next = nullptr; // Uncarved rest of the current slab
+        char* end = nullptr;
+    };
+
+    SizeClass classes[NUM_CLASSES];
+    std::mutex slabs_mtx;
+    std::vector<std::unique_ptr<char[]>> slabs;
+    std::unordered_set<Record*> large; // Records allocated outside the slabs
+
+    static ll classOf(ll bytes) {
+        ll rounded = (ll)std::bit_ceil((uint64_t)std::max(bytes, MIN_RECORD));
+        return std::countr_zero((uint64_t)(rounded / MIN_RECORD));
+    }
+
+    Record* carve(ll cls) {
+        SizeClass& c = classes[cls];
+        ll bytes = MIN_RECORD << cls;
+        if (c.next == c.end) {
+            char* slab = new char[SLAB_BYTES];
+            {
+                std::lock_guard<std::mutex> guard(slabs_mtx);
+                slabs.emplace_back(slab);
+            }
+            c.next = slab;
+            c.end = slab + SLAB_BYTES / bytes * bytes;
+        }
+        Record* r = new (c.next) Record();
+        r->sizeClass = cls;
+        c.next += bytes;
+        return r;
+    }
+
+public:
+    SlabArena() = default;
+
+    SlabArena(const SlabArena&) = delete;
+    SlabArena& operator=(const SlabArena&) = delete;
+
+    ~SlabArena() {
+        for (Record* r : large) {
+            r->~Record();
+            ::operator delete(r);
+        }
+    }
+
+    Record* allocate(ll size) {
+        ll bytes = sizeof(Record) + size;
+        if (bytes > MAX_RECORD) {
+            Record* r = new (::operator new(bytes)) Record();
+            r->sizeClass = -1;
+            r->size = size;
+            std::lock_guard<std::mutex> guard(slabs_mtx);
+            large.insert(r);
+            return r;
+        }
+
+        ll cls = classOf(bytes);
+        SizeClass& c = classes[cls];
+        Record* r;
+        {
+            std::lock_guard<std::mutex> guard(c.mtx);
+            if (c.free.empty()) {
+                r = carve(cls);
+            }
+            else {
+                r = c.free.back();
+                c.free.pop_back();
+            }
+        }
+        r->size = size;
+        return r;
+    }
+
+    // Bytes taken from the system for slabs, whether their records are in use or free
+    ll slabBytes() {
+        std::lock_guard<std::mutex> guard(slabs_mtx);
+        return (ll)slabs.size() * SLAB_BYTES;
+    }
+
+    void free(Record* r) {
+        if (r->sizeClass < 0) {
+            {
+                std::lock_guard<std::mutex> guard(slabs_mtx);
+                large.erase(r);
+            }
+            r->~Record();
+            ::operator delete(r);
+            return;
+        }
+
+        SizeClass& c = classes[r->sizeClass];
+        std::lock_guard<std::mutex> guard(c.mtx);
+        c.free.push_back(r);
+    }
+};
+
+} // namespace sched
@@ -0,0 +1,449 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "Common.h"
+#include "HotItems.h"
+#include "ItemTable.h"
+#include "ParallelValidator.h"
+#include "Signature.h"
+#include "Simd.h"
+#include "Timestamps.h"
+
+namespace sched {
+
+namespace bocc {
+
+// Transaction class
+class Transaction {
+public:
+    ll id;
+    std::vector<ll> read_set; // Flat, in read order, so that validation can gather over it
+    std::set<ll> write_set;
+    std::map<ll, ll> write_vals; // Map from item index to new value
+    std::vector<std::pair<ll, ll>> scans; // Ranges [from, to) read by scan()
+    Signature reads, writes; // Summaries of the read set, scanned ranges included, and of the write set
+    ll startSeq; // Writers that had committed when the transaction started
+    ll checkedSeq; // Early-abort mode: writers tested against the read set so far
+    bool doomed = false; // Early-abort mode: an item read has been overwritten since the start
+    ll startTime; // Logical, from the scheduler's TimestampOracle
+    ll endTime; // Taken by writers only
+
+    Transaction(ll id, ll startSeq, ll startTime)
+        : id(id), startSeq(startSeq), checkedSeq(startSeq), startTime(startTime), endTime(-1) {}
+};
+
+enum class RecordTest {
+    CLEAR,      // The writer wrote none of the items read
+    HIT,        // It may have; also when its slot has been reused
+    UNPUBLISHED // It has not published its signature yet
+};
+
+// Write set signature of a committed transaction in the ring of recent commits
+struct CommitRecord {
+    std::atomic<ll> seq{-2}; // Number of the commit it holds, -1 while it is rewritten
+    Signature writes;
+};
+
+constexpr ll RECENT_COMMITS = 256;
+
+// Item class
+class Item {
+    std::mutex lck;
+
+public:
+    void lock() {
+        lck.lock();
+    }
+
+    void unlock() {
+        lck.unlock();
+    }
+};
+
+} // namespace bocc
+
+// Backward Oriented Concurrency Control: a committing transaction is validated
+// against the writes of transactions that committed after it started.
+//
+// Validation keeps one flat array with the endTime of the last committed write
+// of every item, instead of a write list per item: a read set passes if the
+// largest endTime gathered over it is no later than the startTime of the
+// transaction, one vector gather per four or eight items (see Simd.h). Both
+// times come from a logical clock (see Timestamps.h), so commits never tie
+// and a write that committed after the transaction started is always later.
+//
+// Before that, the write signatures of the transactions that committed since
+// the validating one started are ANDed with its read signature, from a ring
+// of the last RECENT_COMMITS writers. When none of them hits, the transaction
+// passes without looking at its read set. A hit, or a ring that has wrapped
+// since the transaction started, falls back to the exact check.
+// setParallelValidation() spreads the exact check of large read sets over
+// helper threads.
+//
+// In the early-abort mode, every read, write and scan also tests the writers
+// published since the previous one against the read signature, without
+// locks, and confirms a hit on last_write. A transaction found to have read an
+// overwritten item is doomed, and the caller may abort it before it finishes
+// its read phase.
+template <typename Logger = NullLogger>
+class BOCC {
+public:
+    using Transaction = bocc::Transaction;
+
+private:
+    using Item = bocc::Item;
+
+    ItemTable<Item> db; // Database
+    ItemArray<ll> values; // Item values, contiguous so that scans vectorize
+    ItemArray<ll> last_write; // endTime of the last committed write of each item, 0 if none
+    std::atomic<ll> ctr; // Counter for transaction id
+    TimestampOracle clock;
+    Logger logger;
+    HotItemTracker hot;
+
+    std::unique_ptr<ParallelValidator> validator; // Set by setParallelValidation()
+
+    std::vector<bocc::CommitRecord> recent; // Ring of the last writers' signatures
+    std::atomic<ll> commits; // Writers that have taken a place in the ring
+    std::atomic<ll> validations, signaturePasses;
+    bool earlyAbort = false;
+    std::function<void(ll, ll)> value_hook; // Told of every change of a stored value, if set
+
+    // Whether check(from, to) finds a conflict in [0, n), split across the
+    // validator's helpers if there are any
+    bool anyConflict(ll n, const std::function<bool(ll, ll)>& check) {
+        return validator ? validator->anyConflict(n, check) : check(0, n);
+    }
+
+    // last_write is stored under the item locks, but also read without them in the early-abort mode
+    ll lastWrite(ll item_idx) {
+        return std::atomic_ref<ll>(last_write[item_idx]).load(std::memory_order_relaxed);
+    }
+
+    // Called by a validated writer before it releases its locks
+    void publish(Transaction* trans) {
+        ll seq = commits.fetch_add(1);
+        bocc::CommitRecord& rec = recent[seq % bocc::RECENT_COMMITS];
+
+        rec.seq.store(-1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        rec.writes.assign(trans->writes);
+        rec.seq.store(seq, std::memory_order_release);
+    }
+
+    // Whether the signatures of the writers that committed since trans
+    // started prove that none of them wrote an item trans has read. trans
+    // holds the locks of its read set, so a writer that has not published
+    // yet cannot have written any of those items.
+    bool signaturesPass(Transaction* trans) {
+        ll end = commits.load(std::memory_order_acquire);
+        if (end - trans->startSeq > bocc::RECENT_COMMITS) {
+            return false;
+        }
+
+        for (ll seq = trans->startSeq; seq < end; seq++) {
+            if (testRecord(trans, seq) == bocc::RecordTest::HIT) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Test the writer at ring position seq against the read signature of trans
+    bocc::RecordTest testRecord(Transaction* trans, ll seq) {
+        bocc::CommitRecord& rec = recent[seq % bocc::RECENT_COMMITS];
+
+        ll seen = rec.seq.load(std::memory_order_acquire);
+        if (seen != -1 && seen < seq) {
+            return bocc::RecordTest::UNPUBLISHED;
+        }
+        if (seen != seq) {
+            return bocc::RecordTest::HIT; // Being rewritten or overwritten by a newer writer
+        }
+
+        bool hit = rec.writes.intersects(trans->reads);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (hit || rec.seq.load(std::memory_order_relaxed) != seq) {
+            return bocc::RecordTest::HIT;
+        }
+        return bocc::RecordTest::CLEAR;
+    }
+
+    // Whether an item trans has read was written after trans started
+    bool overwritten(Transaction* trans) {
+        for (auto& item_idx: trans->read_set) {
+            if (lastWrite(item_idx) > trans->startTime) {
+                return true;
+            }
+        }
+        for (auto& [from, to]: trans->scans) {
+            for (ll item_idx = from; item_idx < to; item_idx++) {
+                if (lastWrite(item_idx) > trans->startTime) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Early-abort mode: test the writers published since the last check. One
+    // that has not published yet is tested by a later check.
+    void checkDoomed(Transaction* trans) {
+        if (!earlyAbort || trans->doomed) {
+            return;
+        }
+
+        ll end = commits.load(std::memory_order_acquire);
+        bool hit = end - trans->checkedSeq > bocc::RECENT_COMMITS;
+
+        for (; !hit && trans->checkedSeq < end; trans->checkedSeq++) {
+            bocc::RecordTest test = testRecord(trans, trans->checkedSeq);
+            if (test == bocc::RecordTest::UNPUBLISHED) {
+                break;
+            }
+            hit = test == bocc::RecordTest::HIT;
+        }
+
+        // A signature hit may be a false positive. The exact test covers every
+        // writer that has stored its writes, so the ring is done up to end.
+        if (hit) {
+            trans->checkedSeq = end;
+            trans->doomed = overwritten(trans);
+        }
+    }
+
+    void cleanup(std::vector<ll>& readWriteUnion) {
+        // Release the locks
+        for (auto& item_idx: readWriteUnion) {
+            db[item_idx]->unlock();
+        }
+    }
+
+public:
+    template <typename... LoggerArgs>
+    BOCC(ll size, LoggerArgs&&... loggerArgs)
+        : db(size), values(size), last_write(size), logger(std::forward<LoggerArgs>(loggerArgs)...), hot(size), recent(bocc::RECENT_COMMITS),
+          commits(0), validations(0), signaturePasses(0) {
+        ctr.store(1);
+    }
+
+    Transaction* begin() {
+        ll id = ctr.fetch_add(1);
+
+        // startSeq first: a writer counted in it has its commit timestamp, so startTime is not older
+        ll startSeq = commits.load(std::memory_order_acquire);
+        return new Transaction(id, startSeq, clock.now());
+    }
+
+    bool read(Transaction* trans, ll item_idx, ll &localVal) {
+        hot.record(item_idx);
+
+        // If the item is already present in write set of the transaction, read the value it has written in local
+        if (trans->write_set.find(item_idx) != trans->write_set.end()) {
+            localVal = trans->write_vals[item_idx];
+            return true;
+        }
+
+        // Acquire the lock for the database item
+        db[item_idx]->lock();
+
+        localVal = values[item_idx];
+
+        // Release the lock
+        db[item_idx]->unlock();
+
+        logger.log(trans->id, item_idx, Operation::READ);
+
+        // Add item to read set of the transaction
+        trans->read_set.push_back(item_idx);
+        trans->reads.add(item_idx);
+
+        checkDoomed(trans);
+
+        return true;
+    }
+
+    bool write(Transaction* trans, ll item_idx, ll newVal) {
+        hot.record(item_idx);
+
+        // Add item to write set of the transaction
+        trans->write_set.insert(item_idx);
+
+        trans->writes.add(item_idx);
+
+        // Store the new value in the transaction's write
+        trans->write_vals[item_idx] = newVal;
+
+        checkDoomed(trans);
+
+        return true;
+    }
+
+    // Range read of the items [from, to). The items are locked together, so
+    // the scan sees no half-applied write phase. The range is validated as a
+    // whole at commit.
+    bool scan(Transaction* trans, ll from, ll to, ll& sum) {
+        for (ll item_idx = from; item_idx < to; item_idx++) {
+            hot.record(item_idx);
+            db[item_idx]->lock();
+        }
+
+        sum = sumRange(values.data() + from, to - from);
+
+        // Items the transaction has written are read locally
+        for (auto it = trans->write_vals.lower_bound(from); it != trans->write_vals.end() && it->first < to; it++) {
+            sum += it->second - values[it->first];
+        }
+
+        for (ll item_idx = from; item_idx < to; item_idx++) {
+            db[item_idx]->unlock();
+        }
+
+        for (ll item_idx = from; item_idx < to; item_idx++) {
+            logger.log(trans->id, item_idx, Operation::READ);
+        }
+
+        trans->scans.push_back({from, to});
+        for (ll item_idx = from; item_idx < to; item_idx++) {
+            trans->reads.add(item_idx);
+        }
+
+        checkDoomed(trans);
+
+        return true;
+    }
+
+    Status commit(Transaction* trans) {
+        // Union of read set, write set and scanned ranges of the transaction,
+        // sorted so that the locks are taken in a global order
+        std::vector<ll> readWriteUnion(trans->read_set);
+        readWriteUnion.insert(readWriteUnion.end(), trans->write_set.begin(), trans->write_set.end());
+
+        for (auto& [from, to]: trans->scans) {
+            for (ll item_idx = from; item_idx < to; item_idx++) {
+                readWriteUnion.push_back(item_idx);
+            }
+        }
+
+        std::sort(readWriteUnion.begin(), readWriteUnion.end());
+        readWriteUnion.erase(std::unique(readWriteUnion.begin(), readWriteUnion.end()), readWriteUnion.end());
+
+        // Acquire the locks for all items in read-write union
+        for (auto& item_idx: readWriteUnion) {
+            db[item_idx]->lock();
+        }
+
+        // Begin validation phase
+        bool conflict = false;
+        bool hasReads = !trans->read_set.empty() || !trans->scans.empty();
+
+        if (hasReads) {
+            validations++;
+        }
+
+        if (!hasReads || signaturesPass(trans)) {
+            signaturePasses += hasReads;
+        }
+        else {
+            // RS(tj) ∩ WS(ti) is not null for some ti that committed after tj started
+            const ll* reads = trans->read_set.data();
+            conflict = anyConflict(trans->read_set.size(), [&](ll from, ll to) {
+                return maxGather(last_write.data(), reads + from, to - from, -1) > trans->startTime;
+            });
+
+            // Likewise for every item of a scanned range
+            for (auto& [from, to]: trans->scans) {
+                conflict = conflict || maxRange(last_write.data() + from, to - from, -1) > trans->startTime;
+            }
+        }
+
+        if (conflict) {
+            // Abort the transaction
+            cleanup(readWriteUnion);
+
+            return Status::ABORT;
+        }
+
+        // Transaction validated
+        if (!trans->write_set.empty()) {
+            trans->endTime = clock.next();
+        }
+
+        // Write on the database
+        for (auto& [idx, val]: trans->write_vals) {
+            if (value_hook) {
+                value_hook(values[idx], val);
+            }
+            values[idx] = val;
+            std::atomic_ref<ll>(last_write[idx]).store(trans->endTime, std::memory_order_relaxed);
+
+            logger.log(trans->id, idx, Operation::WRITE);
+        }
+
+        if (!trans->write_set.empty()) {
+            publish(trans);
+        }
+
+        cleanup(readWriteUnion);
+
+        logger.log(trans->id, -1, Operation::COMMIT);
+
+        return Status::COMMIT;
+    }
+
+    // Nothing has been written yet, so there is nothing to undo
+    void abort(Transaction*) {}
+
+    // Direct access to the stored values, only while no transaction is active
+    ll value(ll item_idx) const {
+        return values[item_idx];
+    }
+
+    void setValue(ll item_idx, ll val) {
+        values[item_idx] = val;
+    }
+
+    // Call hook(before, after) whenever a write, an install at commit or a
+    // rollback replaces the stored value before with after; only while no
+    // transaction is active
+    void setValueHook(std::function<void(ll, ll)> hook) {
+        value_hook = std::move(hook);
+    }
+
+    // Validate sets of at least minItems items on numHelpers helper threads
+    // together with the committing thread; 0 helpers validates serially
+    void setParallelValidation(ll numHelpers, ll minItems = 4096) {
+        validator.reset(numHelpers > 0 ? new ParallelValidator(numHelpers, minItems) : nullptr);
+    }
+
+    // Test for overwritten reads during the read phase (see doomed())
+    void setEarlyAbort(bool on) {
+        earlyAbort = on;
+    }
+
+    // Early-abort mode: whether the transaction will fail validation anyway
+    bool doomed(Transaction* trans) const {
+        return trans->doomed;
+    }
+
+    void printStats() const {
+        printf("Validations: %lld, passed on signatures alone: %lld (%.1lf%%)\n", validations.load(),
+               signaturePasses.load(), 100.0 * (double)signaturePasses / (double)std::max(1LL, validations.load()));
+    }
+
+    HotItemTracker& hotItems() {
+        return hot;
+    }
+};
+
+} // namespace sched
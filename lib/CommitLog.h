@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Common.h"
+#include "Coro.h"
+
+namespace sched {
+
+// Commit log with group commit.
+//
+// Commit records go into an in-memory buffer; a flusher thread writes out
+// everything appended since its previous flush in one go, so all the commits
+// of a batch become durable together. The device is simulated: a flush takes
+// flushMicros whatever its size. Records are numbered from 1 in append order
+// (their LSN), and a record is durable once durable() has reached its LSN.
+class CommitLog {
+private:
+    ll flushMicros;
+
+    std::mutex mtx;
+    std::condition_variable appendedCv, durableCv;
+    std::vector<ll> buffer; // Transaction ids of the records not yet flushed
+    ll appended = 0;
+    bool stopping = false;
+
+    std::atomic<ll> flushed{0};
+    std::atomic<ll> numFlushes{0};
+    WaitList waiters; // Commits suspended until their record is durable (coroutine mode)
+    std::thread flusher;
+
+    void flushLoop() {
+        std::vector<ll> batch;
+        std::unique_lock<std::mutex> lk(mtx);
+
+        while (true) {
+            appendedCv.wait(lk, [&]() { return stopping || appended > flushed; });
+            if (appended == flushed) {
+                return;
+            }
+
+            batch.swap(buffer);
+            ll upTo = appended;
+            lk.unlock();
+
+            std::this_thread::sleep_for(std::chrono::microseconds(flushMicros));
+            batch.clear();
+
+            lk.lock();
+            flushed = upTo;
+            numFlushes++;
+            durableCv.notify_all();
+
+            lk.unlock();
+            waiters.notify();
+            lk.lock();
+        }
+    }
+
+public:
+    explicit CommitLog(ll flushMicros) : flushMicros(flushMicros) {
+        flusher = std::thread(&CommitLog::flushLoop, this);
+    }
+
+    // Flushes what is left first
+    ~CommitLog() {
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            stopping = true;
+        }
+        appendedCv.notify_one();
+        flusher.join();
+    }
+
+    CommitLog(const CommitLog&) = delete;
+    CommitLog& operator=(const CommitLog&) = delete;
+
+    // Append the commit record of the transaction; returns its LSN
+    ll append(ll transId) {
+        ll lsn;
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            buffer.push_back(transId);
+            lsn = ++appended;
+        }
+        appendedCv.notify_one();
+        return lsn;
+    }
+
+    // LSN up to which every record is durable
+    ll durable() const {
+        return flushed;
+    }
+
+    void waitDurable(ll lsn) {
+        if (flushed >= lsn) {
+            return;
+        }
+        std::unique_lock<std::mutex> lk(mtx);
+        durableCv.wait(lk, [&]() { return flushed >= lsn; });
+    }
+
+    // Coroutine mode: awaitable that resumes once the record is durable
+    auto untilDurable(ll lsn) {
+        return waiters.until([this, lsn]() { return flushed >= lsn; });
+    }
+
+    ll flushes() const {
+        return numFlushes;
+    }
+};
+
+} // namespace sched
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace sched {
+
+typedef long long ll;
+
+enum class Operation {
+    READ,
+    WRITE,
+    COMMIT
+};
+
+// Enum for COMMIT and ABORT
+enum class Status {
+    COMMIT,
+    ABORT
+};
+
+// Number of the calling thread, in the order threads first ask, so that
+// threads spread over per-thread slots
+inline ll threadIndex() {
+    static std::atomic<ll> next{0};
+    thread_local ll index = next.fetch_add(1);
+    return index;
+}
+
+inline ll getCurTime() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(high_resolution_clock::now().time_since_epoch()).count();
+}
+
+// Sum of n contiguous values. A plain loop, so the compiler vectorizes it.
+inline ll sumRange(const ll* vals, ll n) {
+    ll sum = 0;
+    for (ll i = 0; i < n; i++) {
+        sum += vals[i];
+    }
+    return sum;
+}
+
+// Largest of n contiguous values, or lowest if n is 0. Vectorized like sumRange.
+inline ll maxRange(const ll* vals, ll n, ll lowest) {
+    ll result = lowest;
+    for (ll i = 0; i < n; i++) {
+        result = vals[i] > result ? vals[i] : result;
+    }
+    return result;
+}
+
+// Logging policies. Every scheduler reports its reads, writes and commits to
+// its Logger; NullLogger compiles the calls away.
+class NullLogger {
+public:
+    void log(ll, ll, Operation) {}
+};
+
+class FileLogger {
+private:
+    std::mutex log_mtx;
+    std::ofstream logFile;
+
+public:
+    explicit FileLogger(const std::string& path) : logFile(path) {}
+
+    void log(ll transId, ll itemId, Operation op) {
+        ll currTimeLocal = getCurTime();
+
+        std::lock_guard<std::mutex> guard(log_mtx);
+
+        if (op == Operation::READ) {
+            logFile << "Transaction " << transId << " reads item " << itemId << " at time " << currTimeLocal << std::endl;
+        }
+        else if (op == Operation::WRITE) {
+            logFile << "Transaction " << transId << " writes item " << itemId << " at time " << currTimeLocal << std::endl;
+        }
+        else {
+            logFile << "Transaction " << transId << " commits at time " << currTimeLocal << std::endl;
+        }
+    }
+};
+
+// Waiting policies, called on every iteration of a loop that waits for
+// another transaction to make progress
+struct SpinWait {
+    static void pause() {}
+};
+
+struct YieldWait {
+    static void pause() {
+        std::this_thread::yield();
+    }
+};
+
+} // namespace sched
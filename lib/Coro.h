@@ -0,0 +1,327 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "Common.h"
+#include "WorkStealingPool.h"
+
+namespace sched {
+
+// Coroutine support for the "coro" execution mode.
+//
+// Transactions are coroutines resumed by the workers of a CoroExecutor. When
+// an operation would block, the transaction suspends on the WaitList of the
+// item it needs and the worker moves on to another ready transaction. Whoever
+// advances the item's state calls notify(), which hands the ready waiters back
+// to the executor.
+
+class CoroExecutor;
+
+// Pending work of the executor: either a suspended coroutine to resume or the
+// id of a transaction that has not been started yet
+struct CoroTask {
+    std::coroutine_handle<> handle;
+    ll txn = -1;
+};
+
+class CoroExecutor {
+private:
+    WorkStealingPool<CoroTask> pool;
+    std::atomic<ll> inFlight, maxInFlight;
+
+    static inline thread_local CoroExecutor* cur = nullptr;
+    static inline thread_local ll worker = 0;
+
+public:
+    CoroExecutor(ll numWorkers) : pool(numWorkers), inFlight(0), maxInFlight(0) {}
+
+    static CoroExecutor* current() {
+        return cur;
+    }
+
+    static ll currentWorker() {
+        return worker;
+    }
+
+    void submit(ll w, ll txn) {
+        pool.submit(w, CoroTask{nullptr, txn});
+    }
+
+    // Queue a suspended coroutine on the calling worker (worker 0 from outside)
+    void resumeLater(std::coroutine_handle<> h) {
+        pool.reschedule(cur == this ? worker : 0, CoroTask{h, -1});
+    }
+
+    void started() {
+        ll n = ++inFlight;
+        ll prev = maxInFlight;
+        while (n > prev && !maxInFlight.compare_exchange_weak(prev, n));
+    }
+
+    void complete(bool committed) {
+        inFlight--;
+        pool.complete(worker, committed);
+    }
+
+    // Run until every submitted transaction has finished; start(txn) creates
+    // the coroutine of a transaction that has not been started yet
+    template <typename Start, typename OnStart, typename OnExit>
+    void run(Start start, OnStart onStart, OnExit onExit) {
+        pool.run([this, &start](ll w, CoroTask task) {
+            cur = this;
+            worker = w;
+            if (!task.handle) {
+                task.handle = start(task.txn).release();
+            }
+            task.handle.resume();
+        }, onStart, onExit);
+    }
+
+    template <typename Start>
+    void run(Start start) {
+        run(start, [](ll) {}, [](ll) {});
+    }
+
+    ll peakInFlight() const {
+        return maxInFlight;
+    }
+
+    const WorkStealingPool<CoroTask>& workers() const {
+        return pool;
+    }
+};
+
+// Top-level transaction coroutine. It starts suspended, is resumed by the
+// executor and retires itself (reporting whether it committed) when done.
+class Txn {
+public:
+    struct promise_type {
+        bool committed = false;
+
+        Txn get_return_object() {
+            return Txn(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                bool committed = h.promise().committed;
+                h.destroy();
+                CoroExecutor::current()->complete(committed);
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        FinalAwaiter final_suspend() noexcept {
+            return {};
+        }
+
+        void return_value(bool c) {
+            committed = c;
+        }
+
+        void unhandled_exception() {
+            std::terminate();
+        }
+    };
+
+private:
+    std::coroutine_handle<promise_type> h;
+
+    explicit Txn(std::coroutine_handle<promise_type> h) : h(h) {}
+
+public:
+    Txn(Txn&& other) noexcept : h(std::exchange(other.h, nullptr)) {}
+
+    ~Txn() {
+        if (h) {
+            h.destroy();
+        }
+    }
+
+    // Hand the coroutine over to the executor, which resumes it to completion
+    std::coroutine_handle<> release() {
+        CoroExecutor::current()->started();
+        return std::exchange(h, nullptr);
+    }
+};
+
+// Lazily started sub-coroutine; awaiting it runs it to completion and then
+// resumes the awaiting coroutine
+class Task {
+public:
+    struct promise_type {
+        std::coroutine_handle<> continuation;
+
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept {
+                return false;
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                return h.promise().continuation;
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        FinalAwaiter final_suspend() noexcept {
+            return {};
+        }
+
+        void return_void() {}
+
+        void unhandled_exception() {
+            std::terminate();
+        }
+    };
+
+private:
+    std::coroutine_handle<promise_type> h;
+
+    explicit Task(std::coroutine_handle<promise_type> h) : h(h) {}
+
+public:
+    Task(Task&& other) noexcept : h(std::exchange(other.h, nullptr)) {}
+
+    ~Task() {
+        if (h) {
+            h.destroy();
+        }
+    }
+
+    bool await_ready() {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) {
+        h.promise().continuation = awaiting;
+        return h;
+    }
+
+    void await_resume() {}
+};
+
+// Result of starting an operation in coroutine mode: whether the request was
+// granted, and what to co_await before it takes effect (or before retrying)
+template <typename Awaiter>
+struct AsyncOp {
+    bool granted;
+    Awaiter wait;
+};
+
+// Coroutines parked until a condition on some shared state holds.
+//
+// Whoever changes that state must call notify() afterwards. A waiter re-checks
+// its condition under the list mutex after registering, and notify() skips the
+// mutex only when no waiter is registered, so no wakeup is lost.
+class WaitList {
+private:
+    struct Waiter {
+        std::coroutine_handle<> h;
+        CoroExecutor* exec = nullptr;
+        virtual bool ready() = 0;
+    };
+
+    std::mutex mtx;
+    std::vector<Waiter*> waiters;
+    std::atomic<int> numWaiters;
+
+    template <typename Pred, typename Action>
+    struct Awaiter : Waiter {
+        WaitList& list;
+        Pred pred;
+        Action action;
+
+        Awaiter(WaitList& list, Pred pred, Action action) : list(list), pred(pred), action(action) {}
+
+        bool ready() override {
+            return pred();
+        }
+
+        bool await_ready() {
+            return pred();
+        }
+
+        bool await_suspend(std::coroutine_handle<> h) {
+            std::lock_guard<std::mutex> guard(list.mtx);
+            list.numWaiters++;
+            if (pred()) {
+                list.numWaiters--;
+                return false;
+            }
+            this->h = h;
+            this->exec = CoroExecutor::current();
+            list.waiters.push_back(this);
+            return true;
+        }
+
+        void await_resume() {
+            action();
+        }
+    };
+
+public:
+    WaitList() : numWaiters(0) {}
+
+    // Suspend the awaiting coroutine until pred() holds, then run action()
+    template <typename Pred, typename Action>
+    Awaiter<Pred, Action> until(Pred pred, Action action) {
+        return Awaiter<Pred, Action>(*this, pred, action);
+    }
+
+    template <typename Pred>
+    auto until(Pred pred) {
+        return until(pred, []() {});
+    }
+
+    // Reschedule every waiter whose condition now holds
+    void notify() {
+        if (numWaiters == 0) {
+            return;
+        }
+
+        std::vector<std::pair<CoroExecutor*, std::coroutine_handle<>>> woken;
+
+        mtx.lock();
+        for (ll i = 0; i < (ll)waiters.size();) {
+            if (waiters[i]->ready()) {
+                woken.push_back({waiters[i]->exec, waiters[i]->h});
+                waiters[i] = waiters.back();
+                waiters.pop_back();
+                numWaiters--;
+            }
+            else {
+                i++;
+            }
+        }
+        mtx.unlock();
+
+        for (auto& [exec, h] : woken) {
+            exec->resumeLater(h);
+        }
+    }
+};
+
+} // namespace sched
@@ -0,0 +1,440 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "Common.h"
+#include "HotItems.h"
+#include "ItemTable.h"
+#include "ParallelValidator.h"
+#include "Signature.h"
+#include "Simd.h"
+
+namespace sched {
+
+namespace focc {
+
+// Transaction class
+class Transaction {
+public:
+    ll id;
+    std::set<ll> read_set;
+    std::set<ll> write_set;
+    std::map<ll, ll> write_vals; // Map from item index to new value
+    std::map<ll, ll> hot_reads;  // Adaptive mode: items read without joining their read list, with the version seen
+    std::vector<ll> joined;      // Items whose read list counts the transaction
+    Signature reads;             // Summary of joined, tested by committing writers
+    bool registered = false;     // In the registry of active readers
+    bool doomed = false;         // Early-abort mode: wrote an item another transaction is reading
+
+    bool scanned = false; // Has ranges in the scan registry
+
+    Transaction(ll id) : id(id) {}
+};
+
+// Range [from, to) read by an active transaction
+struct ScanRange {
+    ll from, to, transId;
+};
+
+// Item class
+class Item {
+    std::mutex lck;
+
+public:
+    ll version; // Number of committed writes
+
+    Item() {
+        version = 0;
+    }
+
+    void lock() {
+        lck.lock();
+    }
+
+    void unlock() {
+        lck.unlock();
+    }
+};
+
+} // namespace focc
+
+// Forward Oriented Concurrency Control with Committing Transaction Abort: a
+// committing transaction aborts itself if an active transaction has read an
+// item it is about to write.
+//
+// In the adaptive mode, reads of the items the HotItemTracker reports as hot
+// are validated backward instead: the reader stays out of the read list and
+// aborts at commit if the item has been written since. Hot items nearly always
+// have an active reader, so forward validation would abort most of their
+// writers, including for readers that go on to abort themselves.
+//
+// The read lists are kept as one flat array of reader counts. A committing
+// transaction first leaves the read lists it joined, then passes if the
+// largest count gathered over its write set is 0, one vector gather per four
+// or eight items (see Simd.h).
+//
+// Before that, its write signature is ANDed with the read signatures of the
+// active transactions. When none of them hits, no read list can hold one of
+// its items and the transaction passes without the exact check.
+// setParallelValidation() spreads the exact check of large write sets over
+// helper threads.
+//
+// In the early-abort mode, a write of an item that another active transaction
+// has read dooms the writer: unless that reader finishes first, the writer
+// will abort at commit. The test is a lock-free load of the reader count, and
+// the caller may abort a doomed transaction before it finishes its read phase.
+template <typename Logger = NullLogger>
+class FOCC_CTA {
+public:
+    using Transaction = focc::Transaction;
+
+private:
+    using Item = focc::Item;
+
+    ItemTable<Item> db; // Database
+    ItemArray<ll> values; // Item values, contiguous so that scans vectorize
+    ItemArray<ll> readers; // Size of the read list of each item: active transactions that have read it
+    bool earlyAbort = false;
+    std::function<void(ll, ll)> value_hook; // Told of every change of a stored value, if set
+    std::atomic<ll> ctr; // Counter for transaction id
+    Logger logger;
+    HotItemTracker hot;
+
+    std::unique_ptr<ParallelValidator> validator; // Set by setParallelValidation()
+    bool adaptive = false;
+
+    // Transactions that have joined a read list and not finished yet
+    std::vector<Transaction*> activeReaders;
+    std::mutex activeReaders_mtx;
+    std::atomic<ll> validations, signaturePasses;
+
+    // readers is changed under the item locks, but also read without them in the early-abort mode
+    void addReaders(ll item_idx, ll n) {
+        std::atomic_ref<ll> count(readers[item_idx]);
+        count.store(count.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    // Whether check(from, to) finds a conflict in [0, n), split across the
+    // validator's helpers if there are any
+    bool anyConflict(ll n, const std::function<bool(ll, ll)>& check) {
+        return validator ? validator->anyConflict(n, check) : check(0, n);
+    }
+
+    void unregisterReader(Transaction* trans) {
+        if (!trans->registered) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> guard(activeReaders_mtx);
+        std::erase(activeReaders, trans);
+        trans->registered = false;
+    }
+
+    // Whether the signature of another active reader intersects writes
+    bool readerMayConflict(Transaction* trans, const Signature& writes) {
+        std::lock_guard<std::mutex> guard(activeReaders_mtx);
+        for (Transaction* other: activeReaders) {
+            if (other != trans && other->reads.intersects(writes)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Ranges read by active transactions: the read lists of scans
+    std::vector<focc::ScanRange> activeScans;
+    std::mutex activeScans_mtx;
+
+    void unregisterScans(Transaction* trans) {
+        if (!trans->scanned) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> guard(activeScans_mtx);
+        std::erase_if(activeScans, [trans](const focc::ScanRange& r) { return r.transId == trans->id; });
+    }
+
+    // Whether another active transaction has scanned a range holding the item
+    bool scannedByOther(Transaction* trans, ll item_idx) {
+        for (auto& r: activeScans) {
+            if (r.transId != trans->id && r.from <= item_idx && item_idx < r.to) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Remove the transaction from the read lists it has joined
+    // The caller holds the locks of the items
+    void leaveReadLists(Transaction* trans) {
+        for (auto& item_idx: trans->joined) {
+            addReaders(item_idx, -1);
+        }
+        trans->joined.clear();
+    }
+
+    void cleanup(Transaction* trans, std::vector<ll>& readWriteUnion) {
+        // The transaction has already left the read lists of its read set
+        unregisterReader(trans);
+        unregisterScans(trans);
+
+        // Release the locks
+        for (auto& item_idx: readWriteUnion) {
+            db[item_idx]->unlock();
+        }
+    }
+
+public:
+    template <typename... LoggerArgs>
+    FOCC_CTA(ll size, LoggerArgs&&... loggerArgs)
+        : db(size), values(size), readers(size), logger(std::forward<LoggerArgs>(loggerArgs)...), hot(size), validations(0),
+          signaturePasses(0) {
+        ctr.store(1);
+    }
+
+    Transaction* begin() {
+        ll id = ctr.fetch_add(1);
+
+        return new Transaction(id);
+    }
+
+    bool read(Transaction* trans, ll item_idx, ll &localVal) {
+        hot.record(item_idx);
+
+        // If the item is already present in write set of the transaction, read the value it has written in local
+        if (trans->write_set.find(item_idx) != trans->write_set.end()) {
+            localVal = trans->write_vals[item_idx];
+            return true;
+        }
+
+        // Acquire the lock for the database item
+        db[item_idx]->lock();
+
+        localVal = values[item_idx];
+
+        // Add item to read set of the transaction; a repeated read is covered by the first one
+        if (trans->read_set.insert(item_idx).second) {
+            if (adaptive && hot.isHot(item_idx)) {
+                // Validated backward at commit
+                trans->hot_reads.emplace(item_idx, db[item_idx]->version);
+            }
+            else {
+                // Add the transaction to the read list of the item; the
+                // signature bit is set under the item lock, so a writer
+                // validating after this read sees it
+                addReaders(item_idx, 1);
+                trans->joined.push_back(item_idx);
+                trans->reads.add(item_idx);
+
+                if (!trans->registered) {
+                    std::lock_guard<std::mutex> guard(activeReaders_mtx);
+                    activeReaders.push_back(trans);
+                    trans->registered = true;
+                }
+            }
+        }
+
+        // Release the lock
+        db[item_idx]->unlock();
+
+        logger.log(trans->id, item_idx, Operation::READ);
+
+        return true;
+    }
+
+    bool write(Transaction* trans, ll item_idx, ll newVal) {
+        hot.record(item_idx);
+
+        // Add item to write set of the transaction
+        trans->write_set.insert(item_idx);
+
+        // Store the new value in the transaction's write
+        trans->write_vals[item_idx] = newVal;
+
+        if (earlyAbort && !trans->doomed) {
+            // Own reads of the item count too, unless they were hot
+            bool own = trans->read_set.count(item_idx) && !trans->hot_reads.count(item_idx);
+            trans->doomed = std::atomic_ref<ll>(readers[item_idx]).load(std::memory_order_relaxed) > own;
+        }
+
+        return true;
+    }
+
+    // Range read of the items [from, to). The range is registered before its
+    // items are read, so a writer validating from then on sees it, like a read
+    // list covering the whole range; one that validated earlier still holds
+    // its item locks and the scan reads its writes.
+    bool scan(Transaction* trans, ll from, ll to, ll& sum) {
+        {
+            std::lock_guard<std::mutex> guard(activeScans_mtx);
+            activeScans.push_back({from, to, trans->id});
+            trans->scanned = true;
+        }
+
+        for (ll item_idx = from; item_idx < to; item_idx++) {
+            hot.record(item_idx);
+            db[item_idx]->lock();
+        }
+
+        sum = sumRange(values.data() + from, to - from);
+
+        // Items the transaction has written are read locally
+        for (auto it = trans->write_vals.lower_bound(from); it != trans->write_vals.end() && it->first < to; it++) {
+            sum += it->second - values[it->first];
+        }
+
+        for (ll item_idx = from; item_idx < to; item_idx++) {
+            db[item_idx]->unlock();
+        }
+
+        for (ll item_idx = from; item_idx < to; item_idx++) {
+            logger.log(trans->id, item_idx, Operation::READ);
+        }
+
+        return true;
+    }
+
+    Status commit(Transaction* trans) {
+        // Both sets are sorted, so their union is too
+        std::vector<ll> writes(trans->write_set.begin(), trans->write_set.end());
+        std::vector<ll> readWriteUnion; // Union of read set and write set of the transaction
+        std::set_union(trans->read_set.begin(), trans->read_set.end(), writes.begin(), writes.end(),
+                       std::back_inserter(readWriteUnion));
+
+        // Begin validation phase
+
+        // Acquire the locks for all items in read-write union
+        for (auto& item_idx: readWriteUnion) {
+            db[item_idx]->lock();
+        }
+
+        leaveReadLists(trans);
+
+        // Hot items read in the adaptive mode must not have been written since
+        for (auto& [item_idx, version]: trans->hot_reads) {
+            if (db[item_idx]->version != version) {
+                cleanup(trans, readWriteUnion);
+
+                return Status::ABORT;
+            }
+        }
+
+        // A writer first tests its signature against those of the active readers
+        bool mayConflict = false;
+        if (!writes.empty()) {
+            Signature writeSig;
+            for (auto& item_idx: writes) {
+                writeSig.add(item_idx);
+            }
+
+            validations++;
+            mayConflict = readerMayConflict(trans, writeSig);
+            signaturePasses += !mayConflict;
+        }
+
+        // If the read list of any item in the write set is not empty, this transaction will be aborted
+        if (mayConflict && anyConflict(writes.size(), [&](ll from, ll to) {
+                return maxGather(readers.data(), writes.data() + from, to - from, 0) > 0;
+            })) {
+            // Abort the transaction
+            cleanup(trans, readWriteUnion);
+
+            return Status::ABORT;
+        }
+
+        // Likewise for the ranges scanned by active transactions
+        bool scanConflict = false;
+        if (!trans->write_set.empty()) {
+            std::lock_guard<std::mutex> guard(activeScans_mtx);
+            for (auto& item_idx: trans->write_set) {
+                scanConflict = scanConflict || scannedByOther(trans, item_idx);
+            }
+        }
+
+        if (scanConflict) {
+            cleanup(trans, readWriteUnion);
+
+            return Status::ABORT;
+        }
+
+        // Transaction validated
+        // Begin write phase
+        for (auto& [idx, val]: trans->write_vals) {
+            if (value_hook) {
+                value_hook(values[idx], val);
+            }
+            values[idx] = val;
+            db[idx]->version++;
+            logger.log(trans->id, idx, Operation::WRITE);
+        }
+
+        cleanup(trans, readWriteUnion);
+
+        logger.log(trans->id, -1, Operation::COMMIT);
+
+        return Status::COMMIT;
+    }
+
+    // Withdraw the transaction from the read lists it has joined
+    void abort(Transaction* trans) {
+        for (auto& item_idx: trans->joined) {
+            db[item_idx]->lock();
+            addReaders(item_idx, -1);
+            db[item_idx]->unlock();
+        }
+        trans->joined.clear();
+
+        unregisterReader(trans);
+        unregisterScans(trans);
+    }
+
+    // Validate reads of hot items backward instead of forward. Enables the
+    // hot item tracker, which finds the hot items.
+    void setAdaptive(bool on) {
+        adaptive = on;
+        hot.setEnabled(on);
+    }
+
+    // Call hook(before, after) whenever a write, an install at commit or a
+    // rollback replaces the stored value before with after; only while no
+    // transaction is active
+    void setValueHook(std::function<void(ll, ll)> hook) {
+        value_hook = std::move(hook);
+    }
+
+    // Validate sets of at least minItems items on numHelpers helper threads
+    // together with the committing thread; 0 helpers validates serially
+    void setParallelValidation(ll numHelpers, ll minItems = 4096) {
+        validator.reset(numHelpers > 0 ? new ParallelValidator(numHelpers, minItems) : nullptr);
+    }
+
+    // Test written items for active readers during the read phase (see doomed())
+    void setEarlyAbort(bool on) {
+        earlyAbort = on;
+    }
+
+    // Early-abort mode: whether the transaction is likely to abort at commit
+    bool doomed(Transaction* trans) const {
+        return trans->doomed;
+    }
+
+    void printStats() const {
+        printf("Validations: %lld, passed on signatures alone: %lld (%.1lf%%)\n", validations.load(),
+               signaturePasses.load(), 100.0 * (double)signaturePasses / (double)std::max(1LL, validations.load()));
+    }
+
+    HotItemTracker& hotItems() {
+        return hot;
+    }
+};
+
+} // namespace sched
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "Common.h"
+#include "ItemTable.h"
+
+namespace sched {
+
+// Sampled Space-Saving sketch of the most accessed items.
+//
+// Schedulers call record() on every read and write; it returns at once unless
+// the tracker is enabled (setEnabled(), e.g. by a scheduler's adaptive mode).
+// One access in sampleEvery per thread then reaches the sketch, which keeps
+// capacity counters under a mutex; every other call is an increment of the
+// thread's own tick slot in this tracker. An item is hot when its
+// guaranteed count (estimate minus error) is at least hotShare of the recent
+// samples. Counts are halved every window samples so the hot set follows
+// phase changes. isHot() is a relaxed load of a per-item flag.
+class HotItemTracker {
+public:
+    struct Entry {
+        ll item, count, error;
+    };
+
+private:
+    static constexpr ll NUM_SLOTS = 64;
+
+    // Sampling tick of the threads mapped to the slot, on a cache line of its own
+    struct alignas(64) Tick {
+        std::atomic<ll> count{0};
+    };
+
+    ll capacity, sampleEvery, window;
+    double hotShare;
+    std::atomic<bool> enabled{false};
+    Tick ticks[NUM_SLOTS];
+
+    std::mutex mtx;
+    std::vector<Entry> entries;
+    ll samples = 0;
+    std::vector<ll> hotSet;
+    ItemArray<std::atomic<bool>> hot; // Zero pages until an item turns hot
+
+    // Slot of the calling thread, the same in every tracker
+    static ll slotOf() {
+        return threadIndex() % NUM_SLOTS;
+    }
+
+    void sample(ll item) {
+        std::lock_guard<std::mutex> guard(mtx);
+
+        samples++;
+
+        auto it = std::find_if(entries.begin(), entries.end(), [item](const Entry& e) { return e.item == item; });
+        if (it != entries.end()) {
+            it->count++;
+        }
+        else if ((ll)entries.size() < capacity) {
+            entries.push_back({item, 1, 0});
+        }
+        else {
+            // Replace the entry with the smallest count, which bounds the new item's error
+            auto min = std::min_element(entries.begin(), entries.end(),
+                                        [](const Entry& a, const Entry& b) { return a.count < b.count; });
+            *min = {item, min->count + 1, min->count};
+        }
+
+        if (samples % (window / 16) == 0) {
+            refresh();
+        }
+        if (samples >= window) {
+            for (auto& e : entries) {
+                e.count /= 2;
+                e.error /= 2;
+            }
+            samples /= 2;
+        }
+    }
+
+    void refresh() {
+        for (ll item : hotSet) {
+            hot[item].store(false, std::memory_order_relaxed);
+        }
+        hotSet.clear();
+
+        for (auto& e : entries) {
+            if (e.count - e.error >= hotShare * samples) {
+                hotSet.push_back(e.item);
+                hot[e.item].store(true, std::memory_order_relaxed);
+            }
+        }
+    }
+
+public:
+    HotItemTracker(ll numItems, ll capacity = 64, ll sampleEvery = 16, ll window = 4096, double hotShare = 0.02)
+        : capacity(capacity), sampleEvery(sampleEvery), window(window), hotShare(hotShare), hot(numItems) {}
+
+    // Threads that share a slot may lose a tick to each other, which only
+    // shifts the sampling
+    void record(ll item) {
+        if (!enabled.load(std::memory_order_relaxed)) {
+            return;
+        }
+        std::atomic<ll>& tick = ticks[slotOf()].count;
+        ll next = tick.load(std::memory_order_relaxed) + 1;
+        tick.store(next, std::memory_order_relaxed);
+        if (next % sampleEvery == 0) {
+            sample(item);
+        }
+    }
+
+    void setEnabled(bool on) {
+        enabled = on;
+    }
+
+    bool isEnabled() const {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    bool isHot(ll item) const {
+        return hot[item].load(std::memory_order_relaxed);
+    }
+
+    // Up to k entries with the largest guaranteed counts, hottest first
+    std::vector<Entry> top(ll k) {
+        std::lock_guard<std::mutex> guard(mtx);
+
+        std::vector<Entry> result = entries;
+        std::sort(result.begin(), result.end(),
+                  [](const Entry& a, const Entry& b) { return a.count - a.error > b.count - b.error; });
+        if ((ll)result.size() > k) {
+            result.resize(k);
+        }
+        return result;
+    }
+
+    ll numHot() {
+        std::lock_guard<std::mutex> guard(mtx);
+        return hotSet.size();
+    }
+};
+
+} // namespace sched
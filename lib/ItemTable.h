@@ -0,0 +1,150 @@
+#pragma once
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "Common.h"
+
+namespace sched {
+
+// Anonymous mapping of at least one byte, zero-filled by the kernel page by
+// page on first touch, with huge pages where the kernel allows them
+inline void* mapZeroed(size_t bytes) {
+    void* region = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (region == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    madvise(region, bytes, MADV_HUGEPAGE);
+    return region;
+}
+
+// Fixed-size table of a scheduler's per-item state, in one bulk region.
+//
+// The region is an anonymous mapping, so reserving it costs nothing and its
+// pages are zero-filled by the kernel on first touch. The items are then
+// constructed in place by one thread per MIN_CHUNK items, up to the number
+// of hardware threads, which also spreads the page faults. Items that are
+// trivially destructible (e.g. a bare mutex) are dropped with the mapping;
+// the others, such as those of O2PL and SS2PL, are destroyed in parallel the
+// same way first.
+//
+// table[i] is a pointer to item i, as with the vector<Item*> it replaces, but
+// the items are contiguous and reaching one is a single address computation.
+template <typename Item>
+class ItemTable {
+private:
+    static constexpr ll MIN_CHUNK = 1 << 16;
+
+    Item* base = nullptr;
+    ll n = 0;
+    size_t bytes = 0;
+
+    // fn(from, to) over chunks of [0, n) on parallel threads
+    template <typename Fn>
+    void forChunks(Fn fn) {
+        ll numThreads = std::min<ll>(std::max(1u, std::thread::hardware_concurrency()), (n + MIN_CHUNK - 1) / MIN_CHUNK);
+        if (numThreads <= 1) {
+            fn(0, n);
+            return;
+        }
+
+        std::vector<std::thread> threads;
+        ll chunk = (n + numThreads - 1) / numThreads;
+        for (ll from = chunk; from < n; from += chunk) {
+            threads.emplace_back(fn, from, std::min(from + chunk, n));
+        }
+        fn(0, chunk);
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+
+public:
+    explicit ItemTable(ll size) : n(size), bytes(std::max<size_t>(1, size * sizeof(Item))) {
+        base = static_cast<Item*>(mapZeroed(bytes));
+
+        forChunks([this](ll from, ll to) {
+            for (ll i = from; i < to; i++) {
+                new (base + i) Item();
+            }
+        });
+    }
+
+    ~ItemTable() {
+        if constexpr (!std::is_trivially_destructible_v<Item>) {
+            forChunks([this](ll from, ll to) {
+                for (ll i = from; i < to; i++) {
+                    base[i].~Item();
+                }
+            });
+        }
+        munmap(base, bytes);
+    }
+
+    ItemTable(const ItemTable&) = delete;
+    ItemTable& operator=(const ItemTable&) = delete;
+
+    Item* operator[](ll i) const {
+        return base + i;
+    }
+
+    ll size() const {
+        return n;
+    }
+};
+
+// Flat array of one value per item, e.g. the item values a scan sums, in an
+// anonymous mapping of its own. Every element starts as all zero bytes, as
+// the kernel hands out the pages, so there is nothing to construct or
+// destroy: setting up and dropping the array is O(1) whatever its size, and
+// a page is only faulted in by the first access to one of its items. T must
+// be trivially destructible and valid as all zero bytes (ll for 0, atomics
+// of 0 or false).
+template <typename T>
+class ItemArray {
+    static_assert(std::is_trivially_destructible_v<T>);
+
+private:
+    T* base = nullptr;
+    ll n = 0;
+    size_t bytes = 0;
+
+public:
+    explicit ItemArray(ll size)
+        : base(static_cast<T*>(mapZeroed(std::max<size_t>(1, size * sizeof(T))))), n(size),
+          bytes(std::max<size_t>(1, size * sizeof(T))) {}
+
+    ~ItemArray() {
+        munmap(base, bytes);
+    }
+
+    ItemArray(const ItemArray&) = delete;
+    ItemArray& operator=(const ItemArray&) = delete;
+
+    T& operator[](ll i) {
+        return base[i];
+    }
+
+    const T& operator[](ll i) const {
+        return base[i];
+    }
+
+    T* data() {
+        return base;
+    }
+
+    const T* data() const {
+        return base;
+    }
+
+    ll size() const {
+        return n;
+    }
+};
+
+} // namespace sched
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <climits>
+#include <cstdint>
+#include <memory>
+
+#include "Common.h"
+
+namespace sched {
+
+// Concurrent hash index from sparse 64-bit keys to dense slots.
+//
+// Open addressing with linear probing over one array of keys, which is kept
+// at most half full so probes stay short and mostly within a cache line. The
+// slot of a key is the cell it landed in, so a key is inserted with a single
+// CAS on an empty cell and lookups only load: find() never blocks or writes.
+// Keys are not removed one by one (callers mark deletion in the value they
+// store for the slot); clear() empties the whole index while no one uses it.
+// Up to maxKeys distinct keys keep the table half full. Past that, probes get
+// longer, and once every cell holds a key insert() fails; no probe goes past
+// numCells cells. EMPTY is reserved and cannot be used as a key.
+class KeyIndex {
+public:
+    static constexpr ll EMPTY = LLONG_MIN;
+
+private:
+    ll numCells;
+    uint64_t mask;
+    std::unique_ptr<std::atomic<ll>[]> keys;
+
+    // splitmix64 finalizer, so that structured keys spread over the table
+    static uint64_t hash(ll key) {
+        uint64_t h = (uint64_t)key;
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+        return h ^ (h >> 31);
+    }
+
+public:
+    explicit KeyIndex(ll maxKeys)
+        : numCells((ll)std::bit_ceil((uint64_t)std::max<ll>(2, 2 * maxKeys))), mask(numCells - 1),
+          keys(new std::atomic<ll>[numCells]) {
+        clear();
+    }
+
+    // Number of slots, i.e. the size of the dense array behind the index
+    ll size() const {
+        return numCells;
+    }
+
+    // Key in the slot, or EMPTY
+    ll keyAt(ll slot) const {
+        return keys[slot].load(std::memory_order_acquire);
+    }
+
+    // Slot of the key, or -1 if it was never inserted
+    ll find(ll key) const {
+        uint64_t cell = hash(key) & mask;
+        for (ll probes = 0; probes < numCells; probes++, cell = (cell + 1) & mask) {
+            ll k = keys[cell].load(std::memory_order_acquire);
+            if (k == key) {
+                return (ll)cell;
+            }
+            if (k == EMPTY) {
+                return -1;
+            }
+        }
+        return -1;
+    }
+
+    // Slot of the key, inserting it if needed; -1 if it is not in and every
+    // cell holds another key
+    ll insert(ll key) {
+        uint64_t cell = hash(key) & mask;
+        for (ll probes = 0; probes < numCells; probes++, cell = (cell + 1) & mask) {
+            ll k = keys[cell].load(std::memory_order_acquire);
+            if (k == EMPTY && keys[cell].compare_exchange_strong(k, key, std::memory_order_acq_rel)) {
+                return (ll)cell;
+            }
+            // A failed CAS left the winner's key in k
+            if (k == key) {
+                return (ll)cell;
+            }
+        }
+        return -1;
+    }
+
+    // Remove every key; only while no other thread uses the index
+    void clear() {
+        for (ll i = 0; i < numCells; i++) {
+            keys[i].store(EMPTY, std::memory_order_relaxed);
+        }
+    }
+};
+
+} // namespace sched
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <climits>
+#include <coroutine>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "Common.h"
+#include "Coro.h"
+#include "KeyIndex.h"
+#include "Scheduler.h"
+
+namespace sched {
+
+// Key-value front end for a scheduler over dense items: maps sparse 64-bit
+// keys to the inner scheduler's items through a KeyIndex, so the key space
+// need not be known or dense up front.
+//
+// A key is present while its value is not ABSENT. A read of a missing key
+// returns ABSENT, inserting a key is writing it and erase() writes ABSENT, so
+// inserts and deletes are ordinary writes that commit or roll back with their
+// transaction. Every key a transaction touches gets an item, present or not,
+// which makes the inner scheduler order a read that misses a key against the
+// insert of that key. Items start at 0 under every scheduler, so values are
+// stored with their sign bit flipped and a fresh item reads as ABSENT.
+//
+// The index holds maxKeys keys comfortably (see KeyIndex.h). Once it is full,
+// an access to a key not in it is refused, and stays refused until
+// reclaim(), which gives the items of absent keys back to the index.
+template <Scheduler S>
+class Keyed {
+public:
+    using Transaction = typename S::Transaction;
+    static constexpr ll ABSENT = LLONG_MIN;
+
+private:
+    ll max_keys;
+    KeyIndex index;
+    S inner;
+
+    static ll flip(ll val) {
+        return val ^ ABSENT;
+    }
+
+    // Awaiter of an inner operation, none if the index had no item for the
+    // key; after a read that took effect, flips the value
+    template <typename Awaiter>
+    struct Flipped {
+        std::optional<Awaiter> wait;
+        ll* val; // Null unless a granted read left a value in it
+
+        bool await_ready() {
+            return !wait || wait->await_ready();
+        }
+
+        auto await_suspend(std::coroutine_handle<> h) {
+            return wait->await_suspend(h);
+        }
+
+        void await_resume() {
+            if (wait) {
+                wait->await_resume();
+            }
+            if (val) {
+                *val = flip(*val);
+            }
+        }
+    };
+
+    template <typename Awaiter>
+    static auto refused() {
+        return AsyncOp{false, Flipped<Awaiter>{std::nullopt, nullptr}};
+    }
+
+public:
+    // The remaining arguments go to the inner scheduler, after its number of items
+    template <typename... Args>
+    explicit Keyed(ll maxKeys, Args&&... args)
+        : max_keys(maxKeys), index(maxKeys), inner(index.size(), std::forward<Args>(args)...) {}
+
+    Transaction* begin() {
+        return inner.begin();
+    }
+
+    // Refused if the index is full and the key is not in it
+    bool read(Transaction* t, ll key, ll& val) {
+        ll slot = index.insert(key);
+        if (slot < 0 || !inner.read(t, slot, val)) {
+            return false;
+        }
+        val = flip(val);
+        return true;
+    }
+
+    bool write(Transaction* t, ll key, ll val) {
+        ll slot = index.insert(key);
+        return slot >= 0 && inner.write(t, slot, flip(val));
+    }
+
+    bool erase(Transaction* t, ll key) {
+        return write(t, key, ABSENT);
+    }
+
+    Status commit(Transaction* t) {
+        return inner.commit(t);
+    }
+
+    void abort(Transaction* t) {
+        inner.abort(t);
+    }
+
+    auto read_async(Transaction* t, ll key, ll& val) requires AsyncScheduler<S> {
+        using Awaiter = decltype(inner.read_async(t, 0, val).wait);
+        ll slot = index.insert(key);
+        if (slot < 0) {
+            return refused<Awaiter>();
+        }
+        auto op = inner.read_async(t, slot, val);
+        return AsyncOp{op.granted, Flipped<Awaiter>{std::move(op.wait), op.granted ? &val : nullptr}};
+    }
+
+    auto write_async(Transaction* t, ll key, ll val) requires AsyncScheduler<S> {
+        using Awaiter = decltype(inner.write_async(t, 0, val).wait);
+        ll slot = index.insert(key);
+        if (slot < 0) {
+            return refused<Awaiter>();
+        }
+        auto op = inner.write_async(t, slot, flip(val));
+        return AsyncOp{op.granted, Flipped<Awaiter>{std::move(op.wait), nullptr}};
+    }
+
+    auto erase_async(Transaction* t, ll key) requires AsyncScheduler<S> {
+        return write_async(t, key, ABSENT);
+    }
+
+    auto commit_async(Transaction* t) requires AsyncScheduler<S> {
+        return inner.commit_async(t);
+    }
+
+    bool cascaded(Transaction* t) const requires CascadingAbort<S> {
+        return inner.cascaded(t);
+    }
+
+    // Whether the key was used since the last reclaim(); a true answer does
+    // not mean it is present
+    bool known(ll key) const {
+        return index.find(key) >= 0;
+    }
+
+    // Rebuild the index from the keys that are present, so that the items of
+    // erased keys, and of keys that were only read, can be used again. One
+    // inner transaction reads every item and moves the present values to
+    // their new items. Only while no other transaction is active; false, with
+    // nothing changed, if the inner scheduler refuses it.
+    bool reclaim() {
+        ll n = index.size();
+        Transaction* t = inner.begin();
+        KeyIndex fresh(max_keys);
+        std::vector<ll> before(n), after(n, flip(ABSENT));
+
+        bool ok = true;
+        for (ll slot = 0; slot < n && ok; slot++) {
+            ok = inner.read(t, slot, before[slot]);
+        }
+        for (ll slot = 0; slot < n && ok; slot++) {
+            if (before[slot] != flip(ABSENT)) {
+                after[fresh.insert(index.keyAt(slot))] = before[slot];
+            }
+        }
+        for (ll slot = 0; slot < n && ok; slot++) {
+            if (after[slot] != before[slot]) {
+                ok = inner.write(t, slot, after[slot]);
+            }
+        }
+
+        if (!ok) {
+            inner.abort(t);
+        }
+        else if (inner.commit(t) != Status::COMMIT) {
+            ok = false;
+        }
+        delete t;
+
+        if (ok) {
+            index = std::move(fresh);
+        }
+        return ok;
+    }
+
+    S& scheduler() {
+        return inner;
+    }
+};
+
+} // namespace sched
@@ -0,0 +1,869 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "Common.h"
+#include "Coro.h"
+#include "HotItems.h"
+#include "ItemTable.h"
+
+namespace sched {
+
+namespace o2pl {
+
+// Read and write counts packed in one word, writes in the high half, so that
+// one RMW updates both counts of an item and one load reads them together.
+// Each count holds up to 2^32 operations per item.
+constexpr ll WRITE_UNIT = 1LL << 32;
+
+inline ll writesOf(ll counts) {
+    return counts / WRITE_UNIT;
+}
+
+inline ll readsOf(ll counts) {
+    return counts % WRITE_UNIT;
+}
+
+inline ll unitOf(Operation op) {
+    return op == Operation::READ ? 1 : WRITE_UNIT;
+}
+
+// Place of an operation in its item's order: the writes and reads with
+// earlier tickets. Consecutive reads get the same writes and form a reader
+// group, admitted together once the write before them has executed.
+struct Ticket {
+    ll writes, reads;
+};
+
+// The transaction's own operations with earlier tickets on the item; they are
+// released together with the one waiting to unlock
+struct Own {
+    ll reads, writes;
+};
+
+// Tickets given up by aborted transactions, to be counted once every earlier
+// ticket of the item has been (see O2PL::settle())
+struct Skipped {
+    std::vector<Ticket> reads, writes;
+};
+
+// Tickets of an item issued after an aborted write and before the abort:
+// positions [from, to) in the order of its packed issued counts. Any of them
+// may have seen the aborted value or built on it, so their transactions
+// abort at commit. value is what the item was restored to, and what the
+// aborts of those transactions restore it to in turn.
+struct Dirty {
+    ll from, to, value;
+};
+
+class Transaction {
+public:
+    ll id;
+    // Map of item id to the tickets and types of the operations on it
+    std::map<ll, std::vector<std::pair<Ticket, Operation>>> operations;
+    // Value of each written item before the transaction's first write, restored
+    // on abort, and the value it wrote last
+    std::map<ll, std::pair<ll, ll>> undo;
+    // Declared read-only (see O2PL::beginReadOnly()): its reads unlock as they
+    // execute, and are only kept for the checks at commit
+    bool readOnly;
+    // Microseconds the transaction may spend waiting in all, 0 for no limit (threads mode)
+    ll waitBudget;
+    ll waited = 0;
+    bool timedOut = false; // A wait ran out of budget; the transaction must abort
+    bool cascaded = false; // Aborted at commit, as it followed a write that aborted
+
+    Transaction(ll id, bool readOnly = false, ll waitBudget = 0)
+        : id(id), readOnly(readOnly), waitBudget(waitBudget) {}
+};
+
+// Unlock of a hot item handed to the item's combiner (adaptive mode): either
+// wait until the ticket may be unlocked, or release the packed counts
+struct UnlockRequest {
+    bool release;
+    Ticket ticket;
+    Own own;
+    Operation op;
+    ll counts;
+    std::atomic<bool> done{false};
+    UnlockRequest* next = nullptr;
+};
+
+class Item {
+public:
+    std::atomic<ll> issued, executed, released; // Packed counts of the tickets taken, executed and released
+    WaitList waiters; // Transactions suspended on one of the counters (coroutine mode)
+
+    // Flat combining of unlocks (adaptive mode)
+    std::atomic<UnlockRequest*> published{nullptr};
+    std::atomic<bool> combining{false};
+    std::vector<UnlockRequest*> pending_waits; // Only touched by the combiner
+
+    // Tickets of aborted transactions not yet counted as executed or released
+    std::mutex skip_mtx;
+    std::atomic<ll> num_skipped{0};
+    Skipped skip_exec, skip_release;
+
+    // Ranges of tickets that follow an aborted write, under skip_mtx
+    std::vector<Dirty> dirty;
+    std::atomic<ll> num_dirty{0};
+    // Reads of read-only transactions released before their commit checked
+    // them; the dirty ranges are kept while there are any
+    std::atomic<ll> ro_unchecked{0};
+
+    Item() {
+        issued = 0;
+        executed = 0;
+        released = 0;
+    }
+};
+
+} // namespace o2pl
+
+// Ordered Two Phase Locking.
+//
+// Every operation takes a ticket on its item and executes once all conflicting
+// operations with earlier tickets have executed; locks are released in ticket
+// order at commit. A ticket is one RMW on the item's packed counts, and a
+// wait loads one packed word: a read waits for the writes before its reader
+// group, a write for the writes and reads before it. Writes are applied in
+// place, so later ticket holders may read them before the writer commits.
+//
+// A transaction's repeated accesses to an item are merged where possible. A
+// read of an item it has written returns its own write without a ticket. A
+// write right after its read of an item upgrades the read's ticket to a
+// write ticket in place, if no other ticket has been issued on the item since
+// and every issued one has executed; a read-modify-write then costs one
+// ticket and one unlock wait. Otherwise the access takes its own ticket.
+//
+// abort() does not wait: it restores the values the transaction wrote and
+// gives up its tickets. A given-up ticket is counted as executed and released
+// as soon as every earlier ticket of its item is, so later ticket holders
+// skip it. The abort cascades: on each item it wrote, the tickets issued
+// after its first write there and before the abort are marked (o2pl::Dirty),
+// and a transaction holding one of them aborts at commit, once its unlock
+// waits have seen the aborted write released. Aborts of such followers
+// restore the value the first aborted write restored, not their own earlier
+// values, so the item ends up as it was before it, in whichever order they
+// abort. Tickets issued after the abort see the restored value, or a value
+// written by a follower, whose own abort marks them in turn. With a wait
+// budget (setWaitBudget()), a transaction that waits longer than its budget
+// in all gives up the request it waits on and must abort; the coroutine mode
+// waits without a budget.
+//
+// Transactions declared read-only take a lighter path. Their reads take
+// tickets like any read, with the same single RMW, and unlock as soon as they
+// execute: at once if the writes before them have been released, otherwise
+// through the skipped tickets, which count them in ticket order. A read-only
+// transaction has nothing to release: at commit it only waits until the
+// writes before its reads have been released, to know whether it followed
+// one that aborted. Any other transaction waits once per item it only read,
+// for its last read there, and releases each item with one update.
+//
+// In the adaptive mode, the unlocks of hot items go through flat combining:
+// committers publish their waits and releases on the item, and whichever of
+// them takes the combiner role applies all pending releases at once and hands
+// out the waits that may proceed. Waiters spin on their own request instead of
+// the item's unlock counters.
+template <typename Logger = NullLogger, typename Wait = SpinWait>
+class O2PL {
+public:
+    using Transaction = o2pl::Transaction;
+
+private:
+    using Item = o2pl::Item;
+    using Ticket = o2pl::Ticket;
+    using Own = o2pl::Own;
+    using UnlockRequest = o2pl::UnlockRequest;
+
+    ItemTable<Item> items;
+    ItemArray<ll> values; // Item values, contiguous so that scans vectorize
+    ll size;
+    std::atomic<ll> trans_id_ctr;
+    Logger logger;
+    HotItemTracker hot;
+    bool adaptive = false;
+    ll waitBudget = 0; // Given to new transactions
+    std::function<void(ll, ll)> value_hook; // Told of every change of a stored value, if set
+
+    Ticket get_op_ctr(ll item_id, Operation op) {
+        hot.record(item_id);
+
+        ll before = items[item_id]->issued.fetch_add(o2pl::unitOf(op));
+        return Ticket{o2pl::writesOf(before), o2pl::readsOf(before)};
+    }
+
+    // Whether the operation holding the ticket may execute. A read waits for
+    // the earlier writes, a write also for the earlier reads.
+    static bool can_execute(Item* item, Ticket ticket, Operation op) {
+        ll done = item->executed;
+        if (op == Operation::READ) {
+            return ticket.writes <= o2pl::writesOf(done);
+        }
+        return ticket.writes <= o2pl::writesOf(done) && ticket.reads <= o2pl::readsOf(done);
+    }
+
+    // Whether the operation holding the ticket may release its lock, counting
+    // the transaction's own earlier operations on the item as released
+    static bool can_unlock(Item* item, Ticket ticket, Operation op, Own own) {
+        ll done = item->released;
+        bool writesDone = ticket.writes <= o2pl::writesOf(done) + own.writes;
+        if (op == Operation::READ) {
+            return writesDone;
+        }
+        return writesDone && ticket.reads <= o2pl::readsOf(done) + own.reads;
+    }
+
+    // Values are read and written through atomic_ref, as an abort may restore
+    // one while a later ticket holder uses it
+    void do_read(Transaction* t, ll item_id, Ticket ticket, ll& locVal) {
+        locVal = std::atomic_ref<ll>(values[item_id]).load(std::memory_order_relaxed);
+
+        logger.log(t->id, item_id, Operation::READ);
+
+        executed_read(t, item_id, ticket);
+    }
+
+    // A read-only transaction unlocks the read right away and only keeps the
+    // ticket for its commit, the others hold it until commit
+    void executed_read(Transaction* t, ll item_id, Ticket ticket) {
+        Item* item = items[item_id];
+        item->executed.fetch_add(1);
+        t->operations[item_id].push_back({ticket, Operation::READ});
+        if (t->readOnly) {
+            item->ro_unchecked.fetch_add(1);
+            if (ticket.writes <= o2pl::writesOf(item->released)) {
+                item->released.fetch_add(1);
+            }
+            else {
+                skip(item_id, ticket, Operation::READ, true);
+            }
+        }
+        settle(item);
+        item->waiters.notify();
+    }
+
+    // The transaction's own write of the item, if it has one: read locally,
+    // without a ticket, as no later write can come before its own
+    bool read_own(Transaction* t, ll item_id, ll& locVal) {
+        auto own = t->undo.find(item_id);
+        if (own == t->undo.end()) {
+            return false;
+        }
+
+        locVal = own->second.second;
+
+        logger.log(t->id, item_id, Operation::READ);
+        return true;
+    }
+
+    void store(Transaction* t, ll item_id, ll newVal) {
+        std::atomic_ref<ll> value(values[item_id]);
+        t->undo.try_emplace(item_id, value.load(std::memory_order_relaxed), newVal).first->second.second = newVal;
+
+        if (value_hook) {
+            value_hook(value.exchange(newVal, std::memory_order_relaxed), newVal);
+        }
+        else {
+            value.store(newVal, std::memory_order_relaxed);
+        }
+
+        logger.log(t->id, item_id, Operation::WRITE);
+    }
+
+    void do_write(Transaction* t, ll item_id, Ticket ticket, ll newVal) {
+        store(t, item_id, newVal);
+
+        t->operations[item_id].push_back({ticket, Operation::WRITE});
+
+        items[item_id]->executed.fetch_add(o2pl::WRITE_UNIT);
+        settle(items[item_id]);
+        items[item_id]->waiters.notify();
+    }
+
+    // Write through the transaction's last read ticket on the item, turned
+    // into a write ticket in the same place. Only when it is the last ticket
+    // issued on the item and every issued operation has executed, so that no
+    // one else waits for or has seen anything after it, and the write need
+    // not wait. False if the ticket cannot be upgraded; the write then takes
+    // a ticket of its own.
+    bool upgrade(Transaction* t, ll item_id, ll newVal) {
+        auto found = t->operations.find(item_id);
+        if (found == t->operations.end() || found->second.back().second != Operation::READ) {
+            return false;
+        }
+
+        auto& [ticket, op] = found->second.back();
+        Item* item = items[item_id];
+        ll mine = ticket.writes * o2pl::WRITE_UNIT + ticket.reads + 1; // Issued counts right after the read
+        if (item->executed != mine || !item->issued.compare_exchange_strong(mine, mine + o2pl::WRITE_UNIT - 1)) {
+            return false;
+        }
+
+        hot.record(item_id);
+        op = Operation::WRITE;
+
+        store(t, item_id, newVal);
+
+        // Tickets issued since the upgrade wait for this write to count
+        item->executed.fetch_add(o2pl::WRITE_UNIT - 1);
+        settle(item);
+        item->waiters.notify();
+        return true;
+    }
+
+    // Transactions with a wait budget take the plain unlock path, where they can stop waiting
+    bool combined(Transaction* t, ll item_id) {
+        return adaptive && t->waitBudget == 0 && hot.isHot(item_id);
+    }
+
+    // Spin until ready() holds, within what is left of the transaction's wait
+    // budget; false, with t->timedOut set, if the budget runs out first
+    template <typename Ready>
+    bool wait_until(Transaction* t, Ready ready) {
+        if (t->waitBudget == 0) {
+            while (!ready()) {
+                Wait::pause();
+            }
+            return true;
+        }
+
+        ll start = getCurTime();
+        while (!ready()) {
+            if (t->waited + getCurTime() - start > t->waitBudget) {
+                t->waited += getCurTime() - start;
+                t->timedOut = true;
+                return false;
+            }
+            Wait::pause();
+        }
+        t->waited += getCurTime() - start;
+        return true;
+    }
+
+    // Give up a ticket of an aborting transaction, or the executed read of a
+    // read-only one. It is counted as released, and as executed unless it
+    // already is, once every earlier ticket of the item has been.
+    void skip(ll item_id, Ticket ticket, Operation op, bool executed) {
+        Item* item = items[item_id];
+        {
+            std::lock_guard<std::mutex> guard(item->skip_mtx);
+            if (!executed) {
+                (op == Operation::READ ? item->skip_exec.reads : item->skip_exec.writes).push_back(ticket);
+                item->num_skipped++;
+            }
+            (op == Operation::READ ? item->skip_release.reads : item->skip_release.writes).push_back(ticket);
+            item->num_skipped++;
+        }
+        settle(item);
+    }
+
+    // Count the skipped tickets whose earlier tickets have all been counted,
+    // as long as that lets more of them through. Called after every update
+    // of the counts; a load when nothing is skipped.
+    static void settle(Item* item) {
+        if (item->num_skipped == 0) {
+            return;
+        }
+
+        bool moved = false;
+        {
+            std::lock_guard<std::mutex> guard(item->skip_mtx);
+            while (settle_counts(item, item->executed, item->skip_exec) ||
+                   settle_counts(item, item->released, item->skip_release)) {
+                moved = true;
+            }
+        }
+
+        if (moved) {
+            item->waiters.notify();
+        }
+    }
+
+    // One pass of settle() over one of the packed counts; whether it counted any ticket
+    static bool settle_counts(Item* item, std::atomic<ll>& counts, o2pl::Skipped& skipped) {
+        ll done = counts;
+        bool moved = false;
+
+        // A read is due once the writes before its group are counted, a
+        // write once it is the next write and the reads before it are
+        auto take = [&](std::vector<Ticket>& list, auto due, auto count) {
+            for (ll i = 0; i < (ll)list.size();) {
+                if (due(list[i])) {
+                    count();
+                    list[i] = list.back();
+                    list.pop_back();
+                    item->num_skipped--;
+                    moved = true;
+                }
+                else {
+                    i++;
+                }
+            }
+        };
+
+        take(skipped.reads, [&](const Ticket& t) { return t.writes <= o2pl::writesOf(done); },
+             [&]() { counts.fetch_add(1); });
+
+        if (!moved) {
+            take(skipped.writes,
+                 [&](const Ticket& t) { return t.writes == o2pl::writesOf(done) && t.reads <= o2pl::readsOf(done); },
+                 [&]() { counts.fetch_add(o2pl::WRITE_UNIT); });
+        }
+        return moved;
+    }
+
+    // One combiner pass: apply the published releases in one batch, then
+    // complete the waits that may proceed
+    static void combine(Item* item) {
+        UnlockRequest* req = item->published.exchange(nullptr, std::memory_order_acquire);
+
+        std::vector<UnlockRequest*> releases;
+        ll counts = 0;
+
+        while (req) {
+            UnlockRequest* next = req->next;
+            if (req->release) {
+                counts += req->counts;
+                releases.push_back(req);
+            }
+            else {
+                item->pending_waits.push_back(req);
+            }
+            req = next;
+        }
+
+        if (counts) {
+            item->released.fetch_add(counts);
+            settle(item);
+        }
+
+        // The owners may return as soon as done is set, so do not touch a request after that
+        for (auto* r : releases) {
+            r->done.store(true, std::memory_order_release);
+        }
+
+        auto& waits = item->pending_waits;
+        for (ll i = 0; i < (ll)waits.size();) {
+            if (can_unlock(item, waits[i]->ticket, waits[i]->op, waits[i]->own)) {
+                waits[i]->done.store(true, std::memory_order_release);
+                waits[i] = waits.back();
+                waits.pop_back();
+            }
+            else {
+                i++;
+            }
+        }
+
+        if (counts) {
+            item->waiters.notify();
+        }
+    }
+
+    // Publish the request on the item and wait until a combiner, possibly
+    // this thread, has completed it
+    static void submit(Item* item, UnlockRequest& req) {
+        req.next = item->published.load(std::memory_order_relaxed);
+        while (!item->published.compare_exchange_weak(req.next, &req, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+
+        while (!req.done.load(std::memory_order_acquire)) {
+            if (!item->combining.load(std::memory_order_relaxed) && !item->combining.exchange(true, std::memory_order_acquire)) {
+                combine(item);
+                item->combining.store(false, std::memory_order_release);
+            }
+            else {
+                Wait::pause();
+            }
+        }
+    }
+
+    // Own operations before the k-th one of v that its unlock waits for; they
+    // are released together with it. A scan may add a read after the
+    // transaction's read and write of an item.
+    static Own own_before(const std::vector<std::pair<Ticket, Operation>>& v, ll k) {
+        Own own{0, 0};
+        for (ll i = 0; i < k; i++) {
+            if (v[i].second == Operation::WRITE) {
+                own.writes++;
+            }
+            else if (v[k].second == Operation::WRITE) {
+                own.reads++;
+            }
+        }
+        return own;
+    }
+
+    // Wait until every lock of the transaction may be released; false if its
+    // wait budget runs out first. The tickets of an item increase along v, so
+    // on an item it has not written, the last read waits for the others.
+    bool wait_unlock(Transaction* t) {
+        for (auto& [item_id, v] : t->operations) {
+            ll first = t->undo.count(item_id) ? 0 : (ll)v.size() - 1;
+            for (ll k = first; k < (ll)v.size(); k++) {
+                auto [ticket, op] = v[k];
+                Own own = own_before(v, k);
+
+                if (combined(t, item_id)) {
+                    UnlockRequest req{false, ticket, own, op, 0};
+                    submit(items[item_id], req);
+                    continue;
+                }
+
+                Item* item = items[item_id];
+                if (!wait_until(t, [&]() { return can_unlock(item, ticket, op, own); })) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void release(Transaction* t) {
+        if (t->readOnly) {
+            checked(t);
+            return;
+        }
+
+        for (auto& [item_id, v] : t->operations) {
+            ll counts = 0;
+            for (auto& [ticket, op] : v) {
+                counts += o2pl::unitOf(op);
+            }
+
+            if (combined(t, item_id)) {
+                UnlockRequest req{true, {}, {}, Operation::READ, counts};
+                submit(items[item_id], req);
+                continue;
+            }
+
+            items[item_id]->released.fetch_add(counts);
+            settle(items[item_id]);
+            items[item_id]->waiters.notify();
+        }
+    }
+
+    // A read-only transaction's reads, already released, have been checked
+    void checked(Transaction* t) {
+        for (auto& [item_id, v] : t->operations) {
+            items[item_id]->ro_unchecked.fetch_sub(v.size());
+        }
+    }
+
+    static ll positionOf(Ticket ticket) {
+        return ticket.writes * o2pl::WRITE_UNIT + ticket.reads;
+    }
+
+    // Under the item's skip_mtx: drop the dirty ranges whose tickets have all
+    // been released, as shown by a later write released or nothing left
+    // unreleased, unless a read-only reader has yet to check them
+    static void prune(Item* item) {
+        if (item->ro_unchecked > 0) {
+            return;
+        }
+
+        ll done = item->released, issued = item->issued;
+        std::erase_if(item->dirty, [&](const o2pl::Dirty& d) {
+            return o2pl::writesOf(done) > o2pl::writesOf(d.to) || done >= issued;
+        });
+        item->num_dirty = item->dirty.size();
+    }
+
+    // Restore an item the aborting transaction wrote, its first write there
+    // at position pos. If that write itself follows an aborted one, the item
+    // goes back to what that abort restored. The tickets issued since the
+    // write are then marked, merged with the ranges they overlap.
+    void restore(ll item_id, ll pos, ll before) {
+        Item* item = items[item_id];
+        std::lock_guard<std::mutex> guard(item->skip_mtx);
+        prune(item);
+
+        o2pl::Dirty range{pos + 1, 0, before};
+        for (auto& d : item->dirty) {
+            if (d.from <= pos && pos < d.to) {
+                range.value = d.value;
+            }
+        }
+
+        std::atomic_ref<ll> value(values[item_id]);
+        ll current = value.exchange(range.value, std::memory_order_relaxed);
+        if (value_hook && current != range.value) {
+            value_hook(current, range.value);
+        }
+
+        // After the store, so that a ticket outside the range sees the restored value or a follower's
+        range.to = item->issued;
+        std::erase_if(item->dirty, [&](const o2pl::Dirty& d) {
+            if (d.from >= range.to || d.to <= pos) {
+                return false;
+            }
+            range.from = std::min(range.from, d.from);
+            range.to = std::max(range.to, d.to);
+            return true;
+        });
+        item->dirty.push_back(range);
+        item->num_dirty = item->dirty.size();
+    }
+
+    // Whether a ticket of the transaction follows a write that aborted. Only
+    // once its unlock waits have passed, which saw any such write released,
+    // and so marked.
+    bool follows_abort(Transaction* t) {
+        for (auto& [item_id, v] : t->operations) {
+            Item* item = items[item_id];
+            if (item->num_dirty == 0) {
+                continue;
+            }
+
+            std::lock_guard<std::mutex> guard(item->skip_mtx);
+            prune(item);
+            for (auto& [ticket, op] : v) {
+                ll pos = positionOf(ticket);
+                for (auto& d : item->dirty) {
+                    if (d.from <= pos && pos < d.to) {
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+public:
+    template <typename... LoggerArgs>
+    O2PL(ll m, LoggerArgs&&... loggerArgs) : items(m), values(m), logger(std::forward<LoggerArgs>(loggerArgs)...), hot(m) {
+        trans_id_ctr = 1;
+        size = m;
+    }
+
+    Transaction* begin() {
+        ll id = trans_id_ctr.fetch_add(1);
+        return new Transaction(id, false, waitBudget);
+    }
+
+    // A transaction that will only read and scan
+    Transaction* beginReadOnly() {
+        ll id = trans_id_ctr.fetch_add(1);
+        return new Transaction(id, true, waitBudget);
+    }
+
+    // Waits for the ticket to come up; refused only when the wait budget runs
+    // out, after which the transaction must abort. Reading an item the
+    // transaction has written takes no ticket.
+    bool read(Transaction* t, ll item_id, ll& locVal) {
+        if (read_own(t, item_id, locVal)) {
+            return true;
+        }
+
+        Ticket ticket = get_op_ctr(item_id, Operation::READ);
+
+        if (!wait_until(t, [&]() { return can_execute(items[item_id], ticket, Operation::READ); })) {
+            skip(item_id, ticket, Operation::READ, false);
+            return false;
+        }
+
+        do_read(t, item_id, ticket, locVal);
+        return true;
+    }
+
+    // Not for read-only transactions. A write right after the transaction's
+    // read of the item upgrades the read's ticket when it can.
+    bool write(Transaction* t, ll item_id, ll newVal) {
+        if (upgrade(t, item_id, newVal)) {
+            return true;
+        }
+
+        Ticket ticket = get_op_ctr(item_id, Operation::WRITE);
+
+        if (!wait_until(t, [&]() { return can_execute(items[item_id], ticket, Operation::WRITE); })) {
+            skip(item_id, ticket, Operation::WRITE, false);
+            return false;
+        }
+
+        do_write(t, item_id, ticket, newVal);
+        return true;
+    }
+
+    // Range read of the items [from, to), as one operation. A read ticket is
+    // taken on every item in ascending order and marked executed only after
+    // the whole range has been summed, so no write ordered after the scan can
+    // change a value under it. Scans only wait on writes, and writes never
+    // wait while holding an unexecuted ticket, so the ascending order keeps
+    // concurrent scans free of deadlocks. Running out of wait budget gives up
+    // the whole range.
+    bool scan(Transaction* t, ll from, ll to, ll& sum) {
+        std::vector<Ticket> tickets;
+        for (ll item_id = from; item_id < to; item_id++) {
+            Ticket ticket = get_op_ctr(item_id, Operation::READ);
+            tickets.push_back(ticket);
+
+            if (!wait_until(t, [&]() { return can_execute(items[item_id], ticket, Operation::READ); })) {
+                for (ll k = 0; k < (ll)tickets.size(); k++) {
+                    skip(from + k, tickets[k], Operation::READ, false);
+                }
+                return false;
+            }
+        }
+
+        sum = sumRange(values.data() + from, to - from);
+
+        for (ll item_id = from; item_id < to; item_id++) {
+            logger.log(t->id, item_id, Operation::READ);
+
+            executed_read(t, item_id, tickets[item_id - from]);
+        }
+        return true;
+    }
+
+    // Aborts when the wait budget runs out, or when the transaction followed
+    // a write that aborted (cascaded(t))
+    Status commit(Transaction* t) {
+        if (!wait_unlock(t)) {
+            abort(t);
+            return Status::ABORT;
+        }
+
+        if (follows_abort(t)) {
+            t->cascaded = true;
+            abort(t);
+            return Status::ABORT;
+        }
+
+        logger.log(t->id, -1, Operation::COMMIT);
+
+        release(t);
+        return Status::COMMIT;
+    }
+
+    // Does not wait: the tickets are given up, to be skipped in ticket order
+    void abort(Transaction* t) {
+        for (auto& [item_id, vals] : t->undo) {
+            auto& v = t->operations[item_id];
+            auto first = std::find_if(v.begin(), v.end(), [](auto& entry) { return entry.second == Operation::WRITE; });
+            restore(item_id, positionOf(first->first), vals.first);
+        }
+
+        // A read-only transaction's reads are already unlocked
+        if (t->readOnly) {
+            checked(t);
+        }
+        else {
+            for (auto& [item_id, v] : t->operations) {
+                for (auto& [ticket, op] : v) {
+                    skip(item_id, ticket, op, true);
+                }
+            }
+        }
+        t->operations.clear();
+    }
+
+    // Coroutine mode: the ticket is taken when the operation is started, the
+    // read itself happens once the awaiting transaction is resumed. An access
+    // merged with the transaction's earlier one on the item is ready at once.
+    auto read_async(Transaction* t, ll item_id, ll& locVal) {
+        bool merged = t->undo.count(item_id) > 0;
+        Ticket ticket = merged ? Ticket{} : get_op_ctr(item_id, Operation::READ);
+        Item* item = items[item_id];
+
+        return AsyncOp{true, item->waiters.until(
+            [item, ticket, merged]() { return merged || can_execute(item, ticket, Operation::READ); },
+            [this, t, item_id, ticket, merged, &locVal]() {
+                if (merged) {
+                    read_own(t, item_id, locVal);
+                }
+                else {
+                    do_read(t, item_id, ticket, locVal);
+                }
+            })};
+    }
+
+    auto write_async(Transaction* t, ll item_id, ll newVal) {
+        bool merged = upgrade(t, item_id, newVal);
+        Ticket ticket = merged ? Ticket{} : get_op_ctr(item_id, Operation::WRITE);
+        Item* item = items[item_id];
+
+        return AsyncOp{true, item->waiters.until(
+            [item, ticket, merged]() { return merged || can_execute(item, ticket, Operation::WRITE); },
+            [this, t, item_id, ticket, merged, newVal]() {
+                if (!merged) {
+                    do_write(t, item_id, ticket, newVal);
+                }
+            })};
+    }
+
+    Task commit_async(Transaction* t) {
+        for (auto& [item_id, v] : t->operations) {
+            Item* item = items[item_id];
+            ll first = t->undo.count(item_id) ? 0 : (ll)v.size() - 1;
+            for (ll k = first; k < (ll)v.size(); k++) {
+                auto [ticket, op] = v[k];
+                Own own = own_before(v, k);
+                co_await item->waiters.until([item, ticket, op, own]() { return can_unlock(item, ticket, op, own); });
+            }
+        }
+
+        if (follows_abort(t)) {
+            t->cascaded = true;
+            abort(t);
+            co_return;
+        }
+
+        logger.log(t->id, -1, Operation::COMMIT);
+
+        release(t);
+    }
+
+    // Direct access to the stored values, only while no transaction is active
+    ll value(ll item_id) const {
+        return values[item_id];
+    }
+
+    void setValue(ll item_id, ll val) {
+        values[item_id] = val;
+    }
+
+    // Call hook(before, after) whenever a write, an install at commit or a
+    // rollback replaces the stored value before with after; only while no
+    // transaction is active
+    void setValueHook(std::function<void(ll, ll)> hook) {
+        value_hook = std::move(hook);
+    }
+
+    // Flat-combine the unlocks of hot items (threads mode; the coroutine mode
+    // already parks its waiters instead of spinning). Enables the hot item
+    // tracker, which finds the hot items.
+    void setAdaptive(bool on) {
+        adaptive = on;
+        hot.setEnabled(on);
+    }
+
+    // Wait budget in microseconds of the transactions begun from now on, 0
+    // for none (threads mode). Hot items then take the plain unlock path in
+    // the adaptive mode.
+    void setWaitBudget(ll micros) {
+        waitBudget = micros;
+    }
+
+    // Whether the transaction ran out of wait budget and must abort
+    bool timedOut(Transaction* t) const {
+        return t->timedOut;
+    }
+
+    // Whether the commit aborted the transaction instead, as it followed a
+    // write that aborted; commit_async() reports it only this way
+    bool cascaded(Transaction* t) const {
+        return t->cascaded;
+    }
+
+    HotItemTracker& hotItems() {
+        return hot;
+    }
+};
+
+} // namespace sched
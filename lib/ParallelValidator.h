@@ -0,0 +1,124 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Common.h"
+
+namespace sched {
+
+// Helper threads for the validation of large OCC transactions.
+//
+// The validated set [0, n) is cut into chunks of chunkItems, which the helpers
+// and the committing thread take from a shared counter; the first chunk that
+// finds a conflict stops the others from starting new ones. One transaction
+// uses the helpers at a time: a committer that finds them busy, or whose set
+// is smaller than minItems, validates on its own thread as before.
+//
+// The committer holds the locks of every item it validates, so the helpers
+// read the scheduler's arrays under those locks.
+class ParallelValidator {
+private:
+    ll minItems, chunkItems;
+    std::vector<std::thread> helpers;
+
+    std::mutex owner; // Held by the committer using the helpers
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    ll generation = 0;
+    bool stopping = false;
+
+    // Current job
+    const std::function<bool(ll, ll)>* check = nullptr;
+    ll n = 0, numChunks = 0;
+    std::atomic<ll> next, busy;
+    std::atomic<bool> conflict;
+
+    void work() {
+        ll chunk;
+        while (!conflict.load(std::memory_order_relaxed) && (chunk = next.fetch_add(1)) < numChunks) {
+            ll from = chunk * chunkItems;
+            if ((*check)(from, std::min(from + chunkItems, n))) {
+                conflict = true;
+            }
+        }
+    }
+
+    void helperLoop() {
+        ll seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lk(mtx);
+                cv.wait(lk, [&]() { return stopping || generation != seen; });
+                if (stopping) {
+                    return;
+                }
+                seen = generation;
+            }
+
+            work();
+            busy--;
+        }
+    }
+
+public:
+    ParallelValidator(ll numHelpers, ll minItems = 4096, ll chunkItems = 1024)
+        : minItems(minItems), chunkItems(chunkItems), next(0), busy(0), conflict(false) {
+        for (ll i = 0; i < numHelpers; i++) {
+            helpers.emplace_back(&ParallelValidator::helperLoop, this);
+        }
+    }
+
+    ~ParallelValidator() {
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto& h : helpers) {
+            h.join();
+        }
+    }
+
+    ParallelValidator(const ParallelValidator&) = delete;
+    ParallelValidator& operator=(const ParallelValidator&) = delete;
+
+    // Whether check(from, to) returns true for some chunk of [0, size)
+    bool anyConflict(ll size, const std::function<bool(ll, ll)>& checkChunk) {
+        if (helpers.empty() || size < minItems || !owner.try_lock()) {
+            return checkChunk(0, size);
+        }
+
+        check = &checkChunk;
+        n = size;
+        numChunks = (size + chunkItems - 1) / chunkItems;
+        next = 0;
+        conflict = false;
+        busy = helpers.size();
+
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            generation++;
+        }
+        cv.notify_all();
+
+        work();
+
+        // The helpers still use the job until they leave work()
+        while (busy > 0) {
+            std::this_thread::yield();
+        }
+
+        bool result = conflict;
+        owner.unlock();
+        return result;
+    }
+};
+
+} // namespace sched
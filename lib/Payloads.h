@@ -0,0 +1,361 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include "Arena.h"
+#include "Common.h"
+#include "Coro.h"
+#include "Scheduler.h"
+
+namespace sched {
+
+// Variable-size records on top of a scheduler of ll values.
+//
+// Each item of the inner scheduler holds a handle to an immutable Record (see
+// Arena.h), 0 for the empty record every item starts with. write() copies the
+// bytes into a new record and writes its handle. read() reads the handle and
+// returns a view of the record in place, so reads copy nothing. The inner
+// protocol decides which record a read sees, as it would for a value, and no
+// record changes after it is written, so a view cannot tear.
+//
+// A view stays valid until its transaction ends. Records are reclaimed by
+// epoch: the inner scheduler reports every handle it replaces (ValueHook), and
+// a replaced record is retired at the current global epoch. It goes back to
+// the arena once every transaction active at its retirement has ended, as
+// only those can hold a view of it, or have it in an undo log and restore it
+// on abort, unless it has been stored again by then. The records a
+// transaction wrote are retired when it ends, which frees those that were
+// never stored.
+//
+// Threads are spread over per-thread slots. A slot counts the active
+// transactions that began on it in even and in odd epochs, and keeps the
+// records retired on it. The epoch moves from e to e + 1 once no transaction
+// of epoch e - 1 is active, so once it reaches e + 2 every transaction that
+// began by e has ended, and the records retired at e may go. A transaction
+// thus costs one add on its slot at either end, and a retirement a push to
+// the slot's list under the slot's own mutex, which only threads sharing the
+// slot contend on. A slot's list is freed by the threads on that slot, as
+// they end transactions.
+//
+// The ll interface reads and writes 8-byte records, so that this is a
+// Scheduler as well. Scans and the other scheduler-specific modes are not
+// forwarded.
+template <ValueHook S>
+class Payloads {
+public:
+    class Transaction {
+    public:
+        ll id;
+        typename S::Transaction* inner;
+        ll epoch; // Epoch when it began
+        ll slot; // Slot it was counted on when it began
+        std::vector<Record*> written; // Records it allocated
+        ll pending = 0; // Handle read by its coroutine-mode read in flight
+
+        Transaction(typename S::Transaction* inner, ll epoch, ll slot)
+            : id(inner->id), inner(inner), epoch(epoch), slot(slot) {}
+
+        ~Transaction() {
+            delete inner;
+        }
+    };
+
+private:
+    struct Retired {
+        Record* record;
+        ll gen; // The record's gen when it was retired; a later retirement supersedes it
+        ll epoch;
+    };
+
+    static constexpr ll NUM_SLOTS = 64;
+
+    // Epoch state of the threads mapped to the slot, on a cache line of its own
+    struct alignas(64) Slot {
+        std::atomic<ll> active[2] = {0, 0}; // Active transactions begun here, by parity of their epoch
+        std::mutex mtx; // Guards retired
+        std::deque<Retired> retired; // In epoch order
+    };
+
+    S inner;
+    SlabArena arena;
+
+    alignas(64) std::atomic<ll> epoch{0};
+    Slot slots[NUM_SLOTS];
+
+    std::atomic<ll> num_written{0}, num_reclaimed{0};
+
+    static Record* recordOf(ll handle) {
+        return reinterpret_cast<Record*>(static_cast<uintptr_t>(handle));
+    }
+
+    static std::string_view viewOf(ll handle) {
+        if (handle == 0) {
+            return {};
+        }
+        Record* r = recordOf(handle);
+        return {r->data(), (size_t)r->size};
+    }
+
+    // First 8 bytes of the record, 0 if it is shorter
+    static ll valueOf(ll handle) {
+        std::string_view view = viewOf(handle);
+        ll val = 0;
+        if (view.size() >= sizeof(ll)) {
+            memcpy(&val, view.data(), sizeof(ll));
+        }
+        return val;
+    }
+
+    static void load(ll handle, std::string_view& view) {
+        view = viewOf(handle);
+    }
+
+    static void load(ll handle, ll& val) {
+        val = valueOf(handle);
+    }
+
+    // Slot of the calling thread
+    static ll slotOf() {
+        return threadIndex() % NUM_SLOTS;
+    }
+
+    // Under the slot's mutex. The epoch is read after gen is bumped, so that
+    // a retirement superseding another is not given an older epoch.
+    void retire(Slot& slot, Record* r) {
+        ll gen = ++r->gen;
+        slot.retired.push_back({r, gen, epoch.load()});
+    }
+
+    // Move the epoch from e to e + 1 if no transaction of epoch e - 1 is
+    // active; whether it has moved past e, possibly by another thread
+    bool advance(ll e) {
+        for (auto& slot : slots) {
+            if (slot.active[(e + 1) & 1].load() > 0) {
+                return false;
+            }
+        }
+        epoch.compare_exchange_strong(e, e + 1);
+        return true;
+    }
+
+    // Under the slot's mutex: free the records retired at least two epochs
+    // ago that have not been retired again or stored since, moving the epoch
+    // on where that lets more of them go
+    void reclaim(Slot& slot) {
+        ll e = epoch.load();
+        while (!slot.retired.empty()) {
+            if (slot.retired.front().epoch + 2 > e) {
+                if (!advance(e)) {
+                    break;
+                }
+                e = epoch.load();
+                continue;
+            }
+
+            Retired entry = slot.retired.front();
+            slot.retired.pop_front();
+            if (entry.record->gen == entry.gen && entry.record->stored == 0) {
+                arena.free(entry.record);
+                num_reclaimed++;
+            }
+        }
+    }
+
+    void replaced(ll before, ll after) {
+        if (after != 0) {
+            recordOf(after)->stored++;
+        }
+        if (before != 0) {
+            Record* r = recordOf(before);
+            r->stored--;
+            Slot& slot = slots[slotOf()];
+            std::lock_guard<std::mutex> guard(slot.mtx);
+            retire(slot, r);
+        }
+    }
+
+    // May run on another thread than begin() in the coroutine mode, so the
+    // count goes back on the slot the transaction began on
+    void finish(Transaction* t) {
+        slots[t->slot].active[t->epoch & 1]--;
+
+        Slot& slot = slots[slotOf()];
+        std::lock_guard<std::mutex> guard(slot.mtx);
+        for (Record* r : t->written) {
+            retire(slot, r);
+        }
+        reclaim(slot);
+    }
+
+    Record* copyOf(Transaction* t, std::string_view data) {
+        Record* r = arena.allocate(data.size());
+        memcpy(r->data(), data.data(), data.size());
+        t->written.push_back(r);
+        return r;
+    }
+
+    // A granted write keeps its record until the transaction ends; a refused
+    // one stored nothing, so its record is freed at once
+    void settle(Transaction* t, Record* r, bool granted) {
+        if (granted) {
+            num_written++;
+        }
+        else {
+            t->written.pop_back();
+            arena.free(r);
+        }
+    }
+
+    // Awaiter of an inner read that turns the handle into a record, or a value,
+    // once the read took effect
+    template <typename Awaiter, typename Out>
+    struct Loaded {
+        Awaiter wait;
+        Transaction* t;
+        Out* out; // Null if the read was refused
+
+        bool await_ready() {
+            return wait.await_ready();
+        }
+
+        auto await_suspend(std::coroutine_handle<> h) {
+            return wait.await_suspend(h);
+        }
+
+        void await_resume() {
+            wait.await_resume();
+            if (out) {
+                load(t->pending, *out);
+            }
+        }
+    };
+
+    template <typename Out>
+    auto read_into(Transaction* t, ll item_id, Out& out) {
+        auto op = inner.read_async(t->inner, item_id, t->pending);
+        return AsyncOp{op.granted, Loaded<decltype(op.wait), Out>{std::move(op.wait), t, op.granted ? &out : nullptr}};
+    }
+
+public:
+    // The remaining arguments go to the inner scheduler, after its number of items
+    template <typename... Args>
+    explicit Payloads(ll m, Args&&... args) : inner(m, std::forward<Args>(args)...) {
+        inner.setValueHook([this](ll before, ll after) { replaced(before, after); });
+    }
+
+    // Counted on its slot under the epoch it read, read again in case the
+    // epoch moved on before the count was seen
+    Transaction* begin() {
+        ll index = slotOf();
+        Slot& slot = slots[index];
+        ll e = epoch.load();
+        while (true) {
+            slot.active[e & 1]++;
+            ll now = epoch.load();
+            if (now == e) {
+                break;
+            }
+            slot.active[e & 1]--;
+            e = now;
+        }
+        return new Transaction(inner.begin(), e, index);
+    }
+
+    bool read(Transaction* t, ll item_id, std::string_view& view) {
+        ll handle;
+        if (!inner.read(t->inner, item_id, handle)) {
+            return false;
+        }
+        view = viewOf(handle);
+        return true;
+    }
+
+    bool read(Transaction* t, ll item_id, ll& val) {
+        ll handle;
+        if (!inner.read(t->inner, item_id, handle)) {
+            return false;
+        }
+        val = valueOf(handle);
+        return true;
+    }
+
+    bool write(Transaction* t, ll item_id, std::string_view data) {
+        Record* r = copyOf(t, data);
+        bool granted = inner.write(t->inner, item_id, (ll)reinterpret_cast<uintptr_t>(r));
+        settle(t, r, granted);
+        return granted;
+    }
+
+    bool write(Transaction* t, ll item_id, ll val) {
+        return write(t, item_id, std::string_view(reinterpret_cast<const char*>(&val), sizeof(ll)));
+    }
+
+    Status commit(Transaction* t) {
+        Status status = inner.commit(t->inner);
+        finish(t);
+        return status;
+    }
+
+    void abort(Transaction* t) {
+        inner.abort(t->inner);
+        finish(t);
+    }
+
+    // Coroutine mode: one read in flight per transaction
+    auto read_async(Transaction* t, ll item_id, std::string_view& view) requires AsyncScheduler<S> {
+        return read_into(t, item_id, view);
+    }
+
+    auto read_async(Transaction* t, ll item_id, ll& val) requires AsyncScheduler<S> {
+        return read_into(t, item_id, val);
+    }
+
+    auto write_async(Transaction* t, ll item_id, std::string_view data) requires AsyncScheduler<S> {
+        Record* r = copyOf(t, data);
+        auto op = inner.write_async(t->inner, item_id, (ll)reinterpret_cast<uintptr_t>(r));
+        settle(t, r, op.granted);
+        return op;
+    }
+
+    auto write_async(Transaction* t, ll item_id, ll val) requires AsyncScheduler<S> {
+        return write_async(t, item_id, std::string_view(reinterpret_cast<const char*>(&val), sizeof(ll)));
+    }
+
+    Task commit_async(Transaction* t) requires AsyncScheduler<S> {
+        co_await inner.commit_async(t->inner);
+        finish(t);
+    }
+
+    bool cascaded(Transaction* t) const requires CascadingAbort<S> {
+        return inner.cascaded(t->inner);
+    }
+
+    S& scheduler() {
+        return inner;
+    }
+
+    // Free the retired records of every slot, not only those of the threads
+    // that ended transactions last; only while no transaction is active
+    void quiesce() {
+        for (auto& slot : slots) {
+            std::lock_guard<std::mutex> guard(slot.mtx);
+            reclaim(slot);
+        }
+    }
+
+    void printStats() {
+        ll written = num_written, reclaimed = num_reclaimed;
+        printf("Records: %lld written, %lld reclaimed, %.1lf MB of slabs\n", written, reclaimed,
+               arena.slabBytes() / (1024.0 * 1024.0));
+    }
+};
+
+} // namespace sched
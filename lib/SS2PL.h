@@ -0,0 +1,701 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "CommitLog.h"
+#include "Common.h"
+#include "Coro.h"
+#include "HotItems.h"
+#include "ItemTable.h"
+
+namespace sched {
+
+namespace ss2pl {
+
+class ReaderWriterLock {
+private:
+    std::set<ll> readers;
+    ll writer_id;
+    std::mutex rw_mtx;
+
+public:
+    std::atomic<ll> version; // Bumped on every grant and release
+    WaitList waiters; // Transactions suspended until the lock state changes (coroutine mode)
+
+    ReaderWriterLock() : writer_id(-1), version(0) {}
+
+    bool lock_read(ll transId) {
+        rw_mtx.lock();
+
+        // Edge case of same reader followed by writer
+        if (writer_id == transId) {
+            rw_mtx.unlock();
+            return true;
+        }
+
+        if (writer_id != -1) {
+            rw_mtx.unlock();
+            return false;
+        }
+
+        readers.insert(transId);
+        version++;
+        rw_mtx.unlock();
+        waiters.notify();
+        return true;
+    }
+
+    void unlock_read(ll transId) {
+        rw_mtx.lock();
+        readers.erase(transId);
+        version++;
+        rw_mtx.unlock();
+        waiters.notify();
+    }
+
+    bool lock_write(ll transId) {
+        rw_mtx.lock();
+
+        // Already claimed by the same writer
+        if (writer_id == transId) {
+            rw_mtx.unlock();
+            return true;
+        }
+
+        if ((readers.size() == 1) && (*readers.begin() == transId)) {
+            readers.erase(transId);
+            writer_id = transId;
+            version++;
+            rw_mtx.unlock();
+            waiters.notify();
+            return true;
+        }
+
+        if ((writer_id != -1) || (!readers.empty())) {
+            rw_mtx.unlock();
+            return false;
+        }
+
+        writer_id = transId;
+        version++;
+        rw_mtx.unlock();
+        waiters.notify();
+        return true;
+    }
+
+    void unlock_write() {
+        rw_mtx.lock();
+        writer_id = -1;
+        version++;
+        rw_mtx.unlock();
+        waiters.notify();
+    }
+};
+
+// Modes of a page lock (multi-granularity locking). IS and IX announce read
+// and write locks on items of the page, S and X lock the whole page, and SIX
+// is S together with IX.
+enum class Mode {
+    NONE,
+    IS,
+    IX,
+    S,
+    SIX,
+    X
+};
+
+constexpr ll NUM_MODES = 6;
+
+// Whether a holder of one mode lets another transaction hold the other
+inline bool compatible(Mode a, Mode b) {
+    static constexpr bool table[NUM_MODES][NUM_MODES] = {
+        //          NONE   IS     IX     S      SIX    X
+        /* NONE */ {true,  true,  true,  true,  true,  true},
+        /* IS   */ {true,  true,  true,  true,  true,  false},
+        /* IX   */ {true,  true,  true,  false, false, false},
+        /* S    */ {true,  true,  false, true,  false, false},
+        /* SIX  */ {true,  true,  false, false, false, false},
+        /* X    */ {true,  false, false, false, false, false},
+    };
+    return table[(ll)a][(ll)b];
+}
+
+// Weakest mode that covers both
+inline Mode join(Mode a, Mode b) {
+    static constexpr Mode table[NUM_MODES][NUM_MODES] = {
+        /* NONE */ {Mode::NONE, Mode::IS, Mode::IX, Mode::S, Mode::SIX, Mode::X},
+        /* IS   */ {Mode::IS, Mode::IS, Mode::IX, Mode::S, Mode::SIX, Mode::X},
+        /* IX   */ {Mode::IX, Mode::IX, Mode::IX, Mode::SIX, Mode::SIX, Mode::X},
+        /* S    */ {Mode::S, Mode::S, Mode::SIX, Mode::S, Mode::SIX, Mode::X},
+        /* SIX  */ {Mode::SIX, Mode::SIX, Mode::SIX, Mode::SIX, Mode::SIX, Mode::X},
+        /* X    */ {Mode::X, Mode::X, Mode::X, Mode::X, Mode::X, Mode::X},
+    };
+    return table[(ll)a][(ll)b];
+}
+
+// Lock on a page of consecutive items. The number of holders of each mode is
+// packed in one word, so that a request is one CAS; SIX and X conflict with
+// themselves, so one bit each holds their count. Each transaction holds one
+// mode on the page, changed only to a stronger one.
+class PageLock {
+private:
+    static constexpr ll SHIFT[NUM_MODES] = {0, 0, 22, 44, 62, 63};
+    static constexpr ll BITS[NUM_MODES] = {0, 22, 22, 18, 1, 1};
+
+    std::atomic<uint64_t> holders{0};
+
+    static ll count(uint64_t word, ll mode) {
+        return (word >> SHIFT[mode]) & ((uint64_t(1) << BITS[mode]) - 1);
+    }
+
+    static uint64_t unit(Mode mode) {
+        return mode == Mode::NONE ? 0 : uint64_t(1) << SHIFT[(ll)mode];
+    }
+
+public:
+    std::atomic<ll> version{0}; // Bumped on every release, the only change that can let a request through
+    WaitList waiters; // Transactions suspended until the lock state changes (coroutine mode)
+
+    // Move the caller from held to want; false if another holder conflicts
+    bool lock(Mode held, Mode want) {
+        uint64_t word = holders.load();
+        while (true) {
+            for (ll m = 1; m < NUM_MODES; m++) {
+                ll others = count(word, m) - (m == (ll)held);
+                if (others > 0 && !compatible(want, (Mode)m)) {
+                    return false;
+                }
+            }
+            if (holders.compare_exchange_weak(word, word - unit(held) + unit(want))) {
+                return true;
+            }
+        }
+    }
+
+    void unlock(Mode held) {
+        holders.fetch_sub(unit(held));
+        version++;
+        waiters.notify();
+    }
+};
+
+class Item {
+public:
+    ReaderWriterLock rw_lock;
+    // LSN of the commit record of the last writer that released the item
+    // early (see SS2PL::setCommitLog()); read and written under the lock
+    ll lsn = 0;
+};
+
+class Transaction {
+public:
+    ll id;
+    std::set<ll> read_set, write_set;
+    // Value of each written item before the transaction's first write, restored on abort
+    std::map<ll, ll> undo;
+    // Largest LSN of the early-released writes it has seen; its commit is
+    // not reported before that record is durable
+    ll depends_on = 0;
+    // Mode held on each page it has locked, and the item locks it has taken
+    // on the page since (multi-granularity locking)
+    struct PageHold {
+        Mode mode;
+        ll items;
+    };
+    std::map<ll, PageHold> pages;
+    bool refused_page = false; // The last refused request was refused by a page lock
+
+    Mode page_mode(ll page_id) const {
+        auto held = pages.find(page_id);
+        return held == pages.end() ? Mode::NONE : held->second.mode;
+    }
+
+    Transaction(ll id) : id(id) {}
+};
+
+} // namespace ss2pl
+
+// Strong (strict) Two Phase Locking: a read or write lock is taken on first
+// access and every lock is held until commit or abort. A request that
+// conflicts with another transaction's lock is refused, not queued.
+//
+// A transaction that knows its items up front may instead claim() all its
+// locks before its first access (conservative 2PL). The claim takes them in
+// ascending item order and waits for each in turn; claims only wait for
+// locks above the ones they hold, so they never deadlock, and the
+// transaction's reads and writes are then granted at once. With pages, a
+// claim first takes the intention lock of each page in ascending page order,
+// IX where it writes and IS otherwise, and does not escalate. It therefore
+// never changes a page mode between item locks, and intention modes do not
+// conflict with each other, so claims wait on pages only for transactions
+// that are not waiting.
+//
+// With a commit log (setCommitLog()), a commit appends its record and is
+// reported once the record is durable; the log flushes commits in groups.
+// Locks are normally held until then. Under early lock release they go as
+// soon as the record is in the log buffer, so lock hold times do not include
+// the flush. A transaction that then locks an item written by a commit that
+// is not durable yet depends on it: it does not report its own commit before
+// that record is durable either. The log is flushed in order, so a writer
+// gets this by waiting for its own, later record, and a read-only transaction
+// waits for the record it depends on.
+//
+// With pages (setLockGranularity()), the items are also grouped into pages of
+// consecutive items, each with a multi-granularity lock. An item lock is then
+// taken under an intention lock (IS or IX) on its page, and a transaction that
+// has taken escalateAfter item locks on a page tries to trade them for one S
+// or X lock on the page. A scan locks the whole pages in its range in S mode.
+// Small transactions keep item-level concurrency, and large ones stop paying
+// for a lock per item.
+template <typename Logger = NullLogger, typename Wait = SpinWait>
+class SS2PL {
+public:
+    using Transaction = ss2pl::Transaction;
+
+private:
+    using Item = ss2pl::Item;
+    using ReaderWriterLock = ss2pl::ReaderWriterLock;
+    using PageLock = ss2pl::PageLock;
+    using Mode = ss2pl::Mode;
+
+    ItemTable<Item> items;
+    ItemArray<ll> values; // Item values, contiguous so that scans vectorize
+    ll size;
+    std::atomic<ll> trans_id_ctr;
+    Logger logger;
+    HotItemTracker hot;
+    std::unique_ptr<CommitLog> log; // Null without a commit log
+    bool early_release = false;
+    ll page_size = 0; // Items per page, 0 for item locks only
+    ll escalate_after = 0; // Item locks on one page before escalating, 0 for never
+    std::unique_ptr<PageLock[]> page_locks;
+    std::atomic<ll> num_escalations{0};
+    std::function<void(ll, ll)> value_hook; // Told of every change of a stored value, if set
+
+    // A granted lock: under early lock release, the transaction now depends on
+    // the last early-released write of the item
+    void depend(Transaction* trans, ll item_id) {
+        if (early_release) {
+            trans->depends_on = std::max(trans->depends_on, items[item_id]->lsn);
+        }
+    }
+
+    // Item locks first, as a page lock may be all that keeps others off an item
+    void release(Transaction* trans) {
+        for (auto& item: trans->read_set) {
+            items[item]->rw_lock.unlock_read(trans->id);
+        }
+
+        for (auto& item: trans->write_set) {
+            items[item]->rw_lock.unlock_write();
+        }
+
+        // A refused first request leaves a page with no mode
+        for (auto& [page_id, hold] : trans->pages) {
+            if (hold.mode != Mode::NONE) {
+                page_locks[page_id].unlock(hold.mode);
+            }
+        }
+    }
+
+    // Strengthen the transaction's lock on the page to cover mode
+    bool lock_page(Transaction* trans, ll page_id, Mode mode) {
+        auto& hold = trans->pages.try_emplace(page_id, Transaction::PageHold{Mode::NONE, 0}).first->second;
+        Mode want = ss2pl::join(hold.mode, mode);
+        if (want == hold.mode) {
+            return true;
+        }
+        if (!page_locks[page_id].lock(hold.mode, want)) {
+            trans->refused_page = true;
+            return false;
+        }
+        hold.mode = want;
+        return true;
+    }
+
+    // Trade the transaction's item locks on the page for one S lock, or X if
+    // it writes there, once it has taken escalateAfter of them. Only tried:
+    // the item locks stay if another transaction holds a conflicting mode.
+    void escalate(Transaction* trans, ll page_id) {
+        auto& hold = trans->pages[page_id];
+        if (++hold.items < escalate_after) {
+            return;
+        }
+
+        Mode want = hold.mode == Mode::IS ? Mode::S : Mode::X;
+        if (!page_locks[page_id].lock(hold.mode, want)) {
+            return;
+        }
+        hold = {want, 0};
+        num_escalations++;
+
+        ll from = page_id * page_size, to = from + page_size;
+        for (auto it = trans->read_set.lower_bound(from); it != trans->read_set.end() && *it < to;) {
+            items[*it]->rw_lock.unlock_read(trans->id);
+            it = trans->read_set.erase(it);
+        }
+        for (auto it = trans->write_set.lower_bound(from); it != trans->write_set.end() && *it < to;) {
+            items[*it]->rw_lock.unlock_write();
+            it = trans->write_set.erase(it);
+        }
+    }
+
+    // Take the item's read or write lock, after the intention lock on its
+    // page when there are pages; nothing more if the page lock covers the
+    // item. False if refused, with trans->refused_page telling which lock
+    // refused. A claim takes its locks without escalating.
+    bool acquire(Transaction* trans, ll item_id, bool write, bool may_escalate = true) {
+        trans->refused_page = false;
+
+        if (page_size > 0) {
+            ll page_id = item_id / page_size;
+            Mode held = trans->page_mode(page_id);
+            if (held == Mode::X || (!write && (held == Mode::S || held == Mode::SIX))) {
+                depend(trans, item_id);
+                return true;
+            }
+            if (!lock_page(trans, page_id, write ? Mode::IX : Mode::IS)) {
+                return false;
+            }
+        }
+
+        ReaderWriterLock& rw_lock = items[item_id]->rw_lock;
+        if (!(write ? rw_lock.lock_write(trans->id) : rw_lock.lock_read(trans->id))) {
+            return false;
+        }
+
+        depend(trans, item_id);
+        std::set<ll>& locked = write ? trans->write_set : trans->read_set;
+        locked.emplace_hint(locked.end(), item_id);
+
+        if (may_escalate && escalate_after > 0) {
+            escalate(trans, item_id / page_size);
+        }
+        return true;
+    }
+
+    // The locks of a claim in the order they are taken: ascending items, a
+    // write lock where the item is also written
+    static std::vector<std::pair<ll, bool>> claim_order(std::vector<ll>& reads, std::vector<ll>& writes) {
+        std::sort(reads.begin(), reads.end());
+        std::sort(writes.begin(), writes.end());
+
+        std::vector<std::pair<ll, bool>> order;
+        order.reserve(reads.size() + writes.size());
+        auto w = writes.begin();
+        for (auto r = reads.begin(); r != reads.end() || w != writes.end();) {
+            if (w != writes.end() && (r == reads.end() || *w <= *r)) {
+                ll item_id = *w;
+                while (w != writes.end() && *w == item_id) {
+                    w++;
+                }
+                while (r != reads.end() && *r == item_id) {
+                    r++;
+                }
+                order.push_back({item_id, true});
+            }
+            else {
+                ll item_id = *r;
+                while (r != reads.end() && *r == item_id) {
+                    r++;
+                }
+                order.push_back({item_id, false});
+            }
+        }
+        return order;
+    }
+
+    // The page locks of a claim, taken before its item locks: ascending
+    // pages, each in IX if the claim writes there and IS otherwise
+    std::vector<std::pair<ll, Mode>> claim_pages(const std::vector<std::pair<ll, bool>>& order) const {
+        std::vector<std::pair<ll, Mode>> pages;
+        for (auto [item_id, write] : order) {
+            ll page_id = item_id / page_size;
+            if (pages.empty() || pages.back().first != page_id) {
+                pages.push_back({page_id, Mode::NONE});
+            }
+            pages.back().second = ss2pl::join(pages.back().second, write ? Mode::IX : Mode::IS);
+        }
+        return pages;
+    }
+
+
+    // With a commit log: append the commit record of a writer and return the
+    // LSN the commit has to wait for. Under early lock release the locks go
+    // now, and the items written carry the LSN to later transactions.
+    ll start_commit(Transaction* trans) {
+        ll lsn = trans->depends_on;
+        if (!trans->undo.empty()) {
+            lsn = log->append(trans->id);
+        }
+
+        if (early_release) {
+            for (auto& [item_id, val] : trans->undo) {
+                items[item_id]->lsn = lsn;
+            }
+            release(trans);
+        }
+        return lsn;
+    }
+
+    // Once the record is durable
+    void finish_commit(Transaction* trans) {
+        if (!early_release) {
+            release(trans);
+        }
+
+        logger.log(trans->id, -1, Operation::COMMIT);
+    }
+
+    // Versions of the item's lock and its page's, taken before a request
+    std::pair<ll, ll> versions(ll item_id) {
+        ll page = page_size > 0 ? page_locks[item_id / page_size].version.load() : 0;
+        return {items[item_id]->rw_lock.version, page};
+    }
+
+    // Awaitable that resumes at once if granted, otherwise once the lock that
+    // refused the request, the item's or its page's, has moved past its
+    // version in seen
+    auto retry_after(Transaction* trans, ll item_id, std::pair<ll, ll> seen, bool granted) {
+        ReaderWriterLock& rw_lock = items[item_id]->rw_lock;
+        PageLock* page = !granted && trans->refused_page ? &page_locks[item_id / page_size] : nullptr;
+        WaitList& waiters = page ? page->waiters : rw_lock.waiters;
+        return waiters.until([&rw_lock, page, seen, granted]() {
+            return granted || (page ? page->version != seen.second : rw_lock.version != seen.first);
+        });
+    }
+
+public:
+    template <typename... LoggerArgs>
+    SS2PL(ll m, LoggerArgs&&... loggerArgs) : items(m), values(m), logger(std::forward<LoggerArgs>(loggerArgs)...), hot(m) {
+        trans_id_ctr = 1;
+        size = m;
+    }
+
+    Transaction* begin() {
+        ll id = trans_id_ctr.fetch_add(1);
+        return new Transaction(id);
+    }
+
+    bool read(Transaction* trans, ll item_id, ll& locVal) {
+        hot.record(item_id);
+
+        bool succ = acquire(trans, item_id, false);
+
+        if(!succ) {
+            return false;
+        }
+        locVal = values[item_id];
+
+        logger.log(trans->id, item_id, Operation::READ);
+
+        return true;
+    }
+
+    bool write(Transaction* trans, ll item_id, ll newVal) {
+        hot.record(item_id);
+
+        bool succ = acquire(trans, item_id, true);
+
+        if(!succ) {
+            return false;
+        }
+        trans->undo.emplace(item_id, values[item_id]);
+        if (value_hook) {
+            value_hook(values[item_id], newVal);
+        }
+        values[item_id] = newVal;
+
+        logger.log(trans->id, item_id, Operation::WRITE);
+
+        return true;
+    }
+
+    // Range read of the items [from, to), as one operation. The item set is
+    // fixed, so read locks on every key of the range, held to the end like any
+    // other lock, already lock the range: nothing can be written into it until
+    // the transaction ends. Refused if any lock is held by a writer; the locks
+    // taken so far are kept and the retry takes the rest. With pages, a page
+    // that lies wholly in the range is locked in S mode if it can be, and
+    // item by item otherwise.
+    bool scan(Transaction* trans, ll from, ll to, ll& sum) {
+        for (ll item_id = from; item_id < to;) {
+            if (page_size > 0 && item_id % page_size == 0 && item_id + page_size <= to &&
+                lock_page(trans, item_id / page_size, Mode::S)) {
+                for (ll end = item_id + page_size; item_id < end; item_id++) {
+                    hot.record(item_id);
+                    depend(trans, item_id);
+                }
+                continue;
+            }
+
+            hot.record(item_id);
+
+            if (!acquire(trans, item_id, false)) {
+                return false;
+            }
+            item_id++;
+        }
+
+        sum = sumRange(values.data() + from, to - from);
+
+        for (ll item_id = from; item_id < to; item_id++) {
+            logger.log(trans->id, item_id, Operation::READ);
+        }
+
+        return true;
+    }
+
+    // Conservative 2PL: take read locks on the items of reads and write locks
+    // on those of writes before the transaction's first access, waiting for
+    // each lock in ascending item order. With pages, the page locks come
+    // first, in ascending page order and in the strongest mode the claim
+    // needs on each. Scanned ranges go into reads like any other item.
+    void claim(Transaction* trans, std::vector<ll> reads, std::vector<ll> writes) {
+        auto order = claim_order(reads, writes);
+        if (page_size > 0) {
+            for (auto [page_id, mode] : claim_pages(order)) {
+                while (!lock_page(trans, page_id, mode)) {
+                    Wait::pause();
+                }
+            }
+        }
+
+        for (auto [item_id, write] : order) {
+            while (!acquire(trans, item_id, write, false)) {
+                Wait::pause();
+            }
+        }
+    }
+
+    Status commit(Transaction* trans) {
+        if (log) {
+            log->waitDurable(start_commit(trans));
+            finish_commit(trans);
+            return Status::COMMIT;
+        }
+
+        release(trans);
+
+        logger.log(trans->id, -1, Operation::COMMIT);
+
+        return Status::COMMIT;
+    }
+
+    void abort(Transaction* trans) {
+        for (auto& [item_id, val] : trans->undo) {
+            if (value_hook) {
+                value_hook(values[item_id], val);
+            }
+            values[item_id] = val;
+        }
+
+        release(trans);
+    }
+
+    // Coroutine mode: the request is tried right away; if refused, the
+    // awaitable suspends until the lock of the item changes hands
+    auto read_async(Transaction* trans, ll item_id, ll& locVal) {
+        auto seen = versions(item_id);
+        bool granted = read(trans, item_id, locVal);
+        return AsyncOp{granted, retry_after(trans, item_id, seen, granted)};
+    }
+
+    auto write_async(Transaction* trans, ll item_id, ll newVal) {
+        auto seen = versions(item_id);
+        bool granted = write(trans, item_id, newVal);
+        return AsyncOp{granted, retry_after(trans, item_id, seen, granted)};
+    }
+
+    // Coroutine mode: a claim suspends on a held lock until it changes hands
+    Task claim_async(Transaction* trans, std::vector<ll> reads, std::vector<ll> writes) {
+        auto order = claim_order(reads, writes);
+        if (page_size > 0) {
+            for (auto [page_id, mode] : claim_pages(order)) {
+                ll first = page_id * page_size;
+                while (true) {
+                    auto seen = versions(first);
+                    if (lock_page(trans, page_id, mode)) {
+                        break;
+                    }
+                    co_await retry_after(trans, first, seen, false);
+                }
+            }
+        }
+
+        for (auto [item_id, write] : order) {
+            while (true) {
+                auto seen = versions(item_id);
+                if (acquire(trans, item_id, write, false)) {
+                    break;
+                }
+                co_await retry_after(trans, item_id, seen, false);
+            }
+        }
+    }
+
+    // Suspends, instead of blocking the worker, until the commit record is durable
+    Task commit_async(Transaction* trans) {
+        if (log) {
+            co_await log->untilDurable(start_commit(trans));
+            finish_commit(trans);
+            co_return;
+        }
+
+        commit(trans);
+    }
+
+    // Call hook(before, after) whenever a write, an install at commit or a
+    // rollback replaces the stored value before with after; only while no
+    // transaction is active
+    void setValueHook(std::function<void(ll, ll)> hook) {
+        value_hook = std::move(hook);
+    }
+
+    // Commit through a log whose flushes take flushMicros, with or without
+    // early lock release; 0 for no log. Only while no transaction is active.
+    void setCommitLog(ll flushMicros, bool earlyRelease) {
+        log = flushMicros > 0 ? std::make_unique<CommitLog>(flushMicros) : nullptr;
+        early_release = flushMicros > 0 && earlyRelease;
+    }
+
+    // Null without a commit log
+    const CommitLog* commitLog() const {
+        return log.get();
+    }
+
+    // Group the items into pages of pageSize with multi-granularity locks,
+    // escalating to a page lock after escalateAfter item locks on the page (0
+    // for never); a pageSize of 0 for item locks only. Only while no
+    // transaction is active.
+    void setLockGranularity(ll pageSize, ll escalateAfter) {
+        page_size = pageSize;
+        escalate_after = pageSize > 0 ? escalateAfter : 0;
+        page_locks = pageSize > 0 ? std::make_unique<PageLock[]>((size + pageSize - 1) / pageSize) : nullptr;
+    }
+
+    // Page locks taken in place of item locks so far
+    ll escalations() const {
+        return num_escalations;
+    }
+
+    // Whether the transaction's last refused request was refused by a page lock
+    bool refusedByPage(Transaction* trans) const {
+        return trans->refused_page;
+    }
+
+    HotItemTracker& hotItems() {
+        return hot;
+    }
+};
+
+} // namespace sched
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <concepts>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+#include "CommitLog.h"
+#include "Common.h"
+#include "HotItems.h"
+
+namespace sched {
+
+// Common interface of the schedulers.
+//
+// begin() returns a new transaction owned by the caller, to be deleted after
+// commit() or abort(). read() and write() return false when the request cannot
+// be granted right now (e.g. an SS2PL lock held by another transaction); the
+// caller may retry it later. commit() may return Status::ABORT under the
+// optimistic protocols, in which case the transaction has already been rolled
+// back. abort() rolls back a transaction that has not committed.
+template <typename S>
+concept Scheduler = requires(S s, typename S::Transaction* t, ll item_id, ll& val) {
+    { s.begin() } -> std::same_as<typename S::Transaction*>;
+    { s.read(t, item_id, val) } -> std::same_as<bool>;
+    { s.write(t, item_id, val) } -> std::same_as<bool>;
+    { s.commit(t) } -> std::same_as<Status>;
+    { s.abort(t) } -> std::same_as<void>;
+    { t->id } -> std::convertible_to<ll>;
+};
+
+// Schedulers that can also run transactions as coroutines (see Coro.h).
+//
+// read_async() and write_async() are called where read() and write() would be
+// and return an AsyncOp: whether the request was granted, and an awaitable to
+// co_await before continuing. A granted request takes effect when the
+// awaitable resumes; a refused one resumes once retrying makes sense.
+template <typename S>
+concept AsyncScheduler = Scheduler<S> && requires(S s, typename S::Transaction* t, ll item_id, ll& val) {
+    { s.read_async(t, item_id, val).granted } -> std::convertible_to<bool>;
+    { s.write_async(t, item_id, val).granted } -> std::convertible_to<bool>;
+    s.commit_async(t);
+};
+
+// Schedulers with range reads. scan() reads the items [from, to) as one
+// operation and returns their sum, or false like read() when refused. Scans
+// are phantom-safe: a transaction that commits after scanning a range saw
+// the range as it was at its serialization point, whichever items other
+// transactions write meanwhile (range locks under SS2PL and O2PL, range
+// validation under BOCC and FOCC).
+template <typename S>
+concept ScanScheduler = Scheduler<S> && requires(S s, typename S::Transaction* t, ll from, ll to, ll& sum) {
+    { s.scan(t, from, to, sum) } -> std::same_as<bool>;
+};
+
+// Schedulers with a fast path for transactions known in advance to only read:
+// beginReadOnly() returns a transaction that must not write
+template <typename S>
+concept ReadOnlyHint = Scheduler<S> && requires(S s) {
+    { s.beginReadOnly() } -> std::same_as<typename S::Transaction*>;
+};
+
+// Schedulers that can validate large transactions on helper threads (see
+// ParallelValidator.h)
+template <typename S>
+concept ParallelValidation = Scheduler<S> && requires(S s, ll numHelpers) {
+    s.setParallelValidation(numHelpers);
+};
+
+// Schedulers that can tell during the read phase that a transaction will
+// abort at commit: with setEarlyAbort(true), doomed(t) becomes true once t is
+// known or likely to fail validation, and the caller may abort() it right away
+template <typename S>
+concept EarlyAbort = Scheduler<S> && requires(S s, typename S::Transaction* t, bool on) {
+    s.setEarlyAbort(on);
+    { s.doomed(t) } -> std::same_as<bool>;
+};
+
+// Schedulers that can bound the time a transaction waits: after
+// setWaitBudget(micros), a transaction that has waited longer in all gives up
+// the request it waits on, which is refused with timedOut(t) set, or its
+// commit, which aborts. The caller abort()s a timed-out transaction.
+template <typename S>
+concept WaitBudget = Scheduler<S> && requires(S s, typename S::Transaction* t, ll micros) {
+    s.setWaitBudget(micros);
+    { s.timedOut(t) } -> std::same_as<bool>;
+};
+
+// Schedulers whose commit may abort a transaction because an earlier one
+// aborted: cascaded(t) tells whether it did, which is how a coroutine-mode
+// commit_async() reports it
+template <typename S>
+concept CascadingAbort = Scheduler<S> && requires(S s, typename S::Transaction* t) {
+    { s.cascaded(t) } -> std::same_as<bool>;
+};
+
+// Schedulers that can take every lock of a transaction before its first
+// access (conservative 2PL): claim(t, reads, writes) returns once t holds
+// locks on all those items, after which its reads and writes of them, and its
+// scans within reads, are granted at once. Claims cannot deadlock each other,
+// including with page locks and escalation.
+template <typename S>
+concept PreClaim = Scheduler<S> && requires(S s, typename S::Transaction* t, std::vector<ll> items) {
+    s.claim(t, items, items);
+};
+
+// Schedulers that can commit through a durable log (see CommitLog.h):
+// setCommitLog(flushMicros, earlyRelease) makes a commit wait until its record
+// has been flushed, and with earlyRelease releases its locks before that.
+// commitLog() is null without a log.
+template <typename S>
+concept CommitLogging = Scheduler<S> && requires(S s, ll micros, bool on) {
+    s.setCommitLog(micros, on);
+    { s.commitLog() } -> std::same_as<const CommitLog*>;
+};
+
+// Schedulers with multi-granularity locking: setLockGranularity(pageSize,
+// escalateAfter) groups the items into pages with intention locks and makes a
+// transaction escalate to a page lock after escalateAfter item locks on one
+// page; escalations() counts how often it did. refusedByPage(t) tells
+// whether t's last refused request was refused by a page lock rather than by
+// the item's own lock.
+template <typename S>
+concept MultiGranularity = Scheduler<S> && requires(S s, typename S::Transaction* t, ll pageSize, ll escalateAfter) {
+    s.setLockGranularity(pageSize, escalateAfter);
+    { s.escalations() } -> std::convertible_to<ll>;
+    { s.refusedByPage(t) } -> std::same_as<bool>;
+};
+
+// Schedulers over sparse keys rather than dense item ids (see Keyed.h): any
+// 64-bit key but LLONG_MIN may be read or written, and erase(t, key) deletes
+// it within t
+template <typename S>
+concept KeyValue = Scheduler<S> && requires(S s, typename S::Transaction* t, ll key) {
+    { s.erase(t, key) } -> std::same_as<bool>;
+};
+
+// Schedulers that report every change of a stored value: after
+// setValueHook(hook), hook(before, after) is called whenever a write, an
+// install at commit or a rollback replaces the value before with after
+template <typename S>
+concept ValueHook = Scheduler<S> && requires(S s, std::function<void(ll, ll)> hook) {
+    s.setValueHook(hook);
+};
+
+// Schedulers whose items hold variable-size records (see Payloads.h): read()
+// into a string_view gives a view of the record that stays valid until the
+// transaction ends, without copying it, and write() of a string_view
+// installs a copy of those bytes as the item's new record
+template <typename S>
+concept PayloadScheduler = Scheduler<S> && requires(S s, typename S::Transaction* t, ll item_id, std::string_view& view) {
+    { s.read(t, item_id, view) } -> std::same_as<bool>;
+    { s.write(t, item_id, std::string_view()) } -> std::same_as<bool>;
+};
+
+// Schedulers that track their most accessed items (see HotItems.h)
+template <typename S>
+concept HotItemAware = Scheduler<S> && requires(S s) {
+    { s.hotItems() } -> std::same_as<HotItemTracker&>;
+};
+
+// Schedulers with an adaptive mode that handles hot items differently
+template <typename S>
+concept Adaptive = HotItemAware<S> && requires(S s, bool on) {
+    s.setAdaptive(on);
+};
+
+} // namespace sched
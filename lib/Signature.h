@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "Common.h"
+
+namespace sched {
+
+// Fixed-size bit signature of a set of items: bit item % BITS is set for every
+// item added. Two sets can only intersect if their signatures do, so an empty
+// AND proves there is no conflict and only a hit needs the exact check. Item
+// ids are dense, so the signature is an exact bitset when there are at most
+// BITS items.
+//
+// One thread adds to a signature while others may test it, so the words are
+// relaxed atomics; callers order a bit after the item it stands for, e.g.
+// by setting it under the item's lock.
+class Signature {
+public:
+    static constexpr ll WORDS = 64;
+    static constexpr ll BITS = WORDS * 64;
+
+private:
+    std::atomic<uint64_t> words[WORDS];
+
+public:
+    Signature() {
+        clear();
+    }
+
+    void clear() {
+        for (ll w = 0; w < WORDS; w++) {
+            words[w].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Only the owner adds
+    void add(ll item) {
+        ll bit = item % BITS;
+        std::atomic<uint64_t>& word = words[bit / 64];
+        word.store(word.load(std::memory_order_relaxed) | (uint64_t(1) << (bit % 64)), std::memory_order_relaxed);
+    }
+
+    void assign(const Signature& other) {
+        for (ll w = 0; w < WORDS; w++) {
+            words[w].store(other.words[w].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+    }
+
+    bool intersects(const Signature& other) const {
+        uint64_t any = 0;
+        for (ll w = 0; w < WORDS; w++) {
+            any |= words[w].load(std::memory_order_relaxed) & other.words[w].load(std::memory_order_relaxed);
+        }
+        return any != 0;
+    }
+};
+
+} // namespace sched
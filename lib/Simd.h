@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "Common.h"
+
+namespace sched {
+
+// Largest of vals[idx[i]] for i in [0, n), or lowest if n is 0. This is the
+// gather-and-compare at the heart of OCC validation: BOCC gathers the last
+// write time of every item read, FOCC the reader count of every item
+// written. The scalar loop is the fallback and the reference of the vector
+// kernels below.
+inline ll maxGatherScalar(const ll* vals, const ll* idx, ll n, ll lowest) {
+    ll result = lowest;
+    for (ll i = 0; i < n; i++) {
+        result = std::max(result, vals[idx[i]]);
+    }
+    return result;
+}
+
+// maxGather with AVX-512 or AVX2 gathers when the build targets them (see
+// O2PL_NATIVE), eight or four items per instruction
+inline ll maxGather(const ll* vals, const ll* idx, ll n, ll lowest) {
+    ll i = 0;
+    ll result = lowest;
+
+#if defined(__AVX512F__)
+    __m512i best = _mm512_set1_epi64(lowest);
+    // The masked forms with every lane set, and the reduction by hand: the
+    // plain intrinsics start from undefined vectors, which GCC warns about
+    for (; i + 8 <= n; i += 8) {
+        __m512i ix = _mm512_loadu_si512(idx + i);
+        __m512i v = _mm512_mask_i64gather_epi64(best, 0xFF, ix, vals, 8);
+        best = _mm512_mask_max_epi64(best, 0xFF, best, v);
+    }
+    alignas(64) ll lanes[8];
+    _mm512_store_si512(lanes, best);
+    result = *std::max_element(lanes, lanes + 8);
+#elif defined(__AVX2__)
+    // No 64-bit max before AVX-512: compare and blend
+    __m256i best = _mm256_set1_epi64x(lowest);
+    for (; i + 4 <= n; i += 4) {
+        __m256i ix = _mm256_loadu_si256((const __m256i*)(idx + i));
+        __m256i v = _mm256_i64gather_epi64(vals, ix, 8);
+        best = _mm256_blendv_epi8(best, v, _mm256_cmpgt_epi64(v, best));
+    }
+    alignas(32) ll lanes[4];
+    _mm256_store_si256((__m256i*)lanes, best);
+    result = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#endif
+
+    return maxGatherScalar(vals, idx + i, n - i, result);
+}
+
+// Kernel maxGather compiles to, for reports
+inline const char* simdKernel() {
+#if defined(__AVX512F__)
+    return "AVX-512";
+#elif defined(__AVX2__)
+    return "AVX2";
+#else
+    return "scalar";
+#endif
+}
+
+} // namespace sched
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+
+#include "Common.h"
+
+namespace sched {
+
+// Logical clock for the start and commit timestamps of OCC transactions.
+//
+// A commit timestamp is taken from a shared counter, so no two commits tie and
+// each one is larger than the start timestamp of every transaction that read
+// the clock before it. A start timestamp is only a read of the counter: it
+// allocates nothing, and transactions that start together may share one.
+// Only writers take commit timestamps, so read-only transactions never write
+// the counter.
+//
+// Batching the counter into per-thread blocks would not keep this order: a
+// commit timestamp from an old block could be smaller than the start of a
+// transaction that began before the commit.
+class TimestampOracle {
+private:
+    alignas(64) std::atomic<ll> clock{0};
+
+public:
+    // Start timestamp: no smaller than every commit timestamp taken before
+    ll now() const {
+        return clock.load();
+    }
+
+    // Commit timestamp: larger than every earlier now() and next()
+    ll next() {
+        return clock.fetch_add(1) + 1;
+    }
+};
+
+} // namespace sched
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Common.h"
+
+namespace sched {
+
+// Work-stealing executor shared by the benchmark drivers.
+//
+// Every worker owns a deque of pending tasks. The owner pops from the back,
+// idle workers steal from the front of a random victim, so a worker that is
+// stuck inside a long transaction does not hold the rest of its share hostage.
+//
+// A "unit" is one transaction: it is counted when submitted and retired when
+// the handler calls complete(). Tasks pushed with reschedule() (e.g. a resumed
+// coroutine) belong to a unit that is already counted.
+template <typename Task>
+class WorkStealingPool {
+public:
+    struct WorkerStats {
+        ll executed = 0;    // Units retired by this worker
+        ll committed = 0;   // Units that committed
+        ll stolen = 0;      // Tasks taken from another worker's deque
+        ll idleTime = 0;    // Microseconds spent without local work
+    };
+
+private:
+    struct alignas(64) Worker {
+        std::deque<Task> tasks;
+        std::mutex mtx;
+        WorkerStats stats;
+    };
+
+    std::vector<Worker> workers;
+    std::atomic<ll> outstanding;
+
+    static ll now() {
+        using namespace std::chrono;
+        return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    void push(ll worker, Task task) {
+        std::lock_guard<std::mutex> guard(workers[worker].mtx);
+        workers[worker].tasks.push_back(std::move(task));
+    }
+
+    bool popLocal(ll worker, Task& task) {
+        std::lock_guard<std::mutex> guard(workers[worker].mtx);
+        if (workers[worker].tasks.empty()) {
+            return false;
+        }
+        task = std::move(workers[worker].tasks.back());
+        workers[worker].tasks.pop_back();
+        return true;
+    }
+
+    bool steal(ll worker, Task& task, std::default_random_engine& rng) {
+        ll n = workers.size();
+        ll start = std::uniform_int_distribution<ll>(0, n - 1)(rng);
+
+        for (ll i = 0; i < n; i++) {
+            ll victim = (start + i) % n;
+            if (victim == worker) {
+                continue;
+            }
+
+            std::lock_guard<std::mutex> guard(workers[victim].mtx);
+            if (workers[victim].tasks.empty()) {
+                continue;
+            }
+            task = std::move(workers[victim].tasks.front());
+            workers[victim].tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+public:
+    WorkStealingPool(ll numWorkers) : workers(numWorkers), outstanding(0) {}
+
+    ll size() const {
+        return workers.size();
+    }
+
+    // Queue a new unit of work on the given worker
+    void submit(ll worker, Task task) {
+        outstanding++;
+        push(worker, std::move(task));
+    }
+
+    // Queue more work for a unit that has already been submitted
+    void reschedule(ll worker, Task task) {
+        push(worker, std::move(task));
+    }
+
+    // Retire a unit; must be called exactly once per submitted unit
+    void complete(ll worker, bool committed) {
+        workers[worker].stats.executed++;
+        workers[worker].stats.committed += committed;
+        outstanding--;
+    }
+
+    // Run handler(worker, task) on numWorkers threads until every unit is retired;
+    // onStart(worker) and onExit(worker) run on each worker thread around its loop
+    template <typename Handler, typename OnStart, typename OnExit>
+    void run(Handler handler, OnStart onStart, OnExit onExit) {
+        std::vector<std::thread> threads;
+
+        for (ll w = 0; w < (ll)workers.size(); w++) {
+            threads.push_back(std::thread([this, w, &handler, &onStart, &onExit]() {
+                onStart(w);
+
+                std::default_random_engine rng(w + 1);
+                ll idleSince = -1;
+                Task task;
+
+                while (true) {
+                    bool found = popLocal(w, task);
+
+                    if (!found) {
+                        if (idleSince < 0) {
+                            idleSince = now();
+                        }
+                        found = steal(w, task, rng);
+                        if (found) {
+                            workers[w].stats.stolen++;
+                        }
+                    }
+
+                    if (!found) {
+                        if (outstanding == 0) {
+                            break;
+                        }
+                        std::this_thread::yield();
+                        continue;
+                    }
+
+                    if (idleSince >= 0) {
+                        workers[w].stats.idleTime += now() - idleSince;
+                        idleSince = -1;
+                    }
+
+                    handler(w, std::move(task));
+                }
+
+                if (idleSince >= 0) {
+                    workers[w].stats.idleTime += now() - idleSince;
+                }
+
+                onExit(w);
+            }));
+        }
+
+        for (auto& th : threads) {
+            th.join();
+        }
+    }
+
+    template <typename Handler>
+    void run(Handler handler) {
+        run(handler, [](ll) {}, [](ll) {});
+    }
+
+    const WorkerStats& stats(ll worker) const {
+        return workers[worker].stats;
+    }
+
+    void printStats() const {
+        ll maxCommitted = 0, totalCommitted = 0;
+
+        for (ll w = 0; w < (ll)workers.size(); w++) {
+            const WorkerStats& s = workers[w].stats;
+            printf("Worker %lld: executed %lld, committed %lld, stolen %lld, idle %lld microseconds\n",
+                   w, s.executed, s.committed, s.stolen, s.idleTime);
+            maxCommitted = std::max(maxCommitted, s.committed);
+            totalCommitted += s.committed;
+        }
+
+        double avgCommitted = (double)totalCommitted / (double)workers.size();
+        printf("Load imbalance (max/avg committed per worker): %.3lf\n",
+               avgCommitted > 0 ? (double)maxCommitted / avgCommitted : 0.0);
+    }
+};
+
+} // namespace sched
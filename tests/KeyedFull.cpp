@@ -0,0 +1,62 @@
+#include <bits/stdc++.h>
+#include "../lib/BOCC.h"
+#include "../lib/FOCC.h"
+#include "../lib/Keyed.h"
+#include "../lib/O2PL.h"
+#include "../lib/SS2PL.h"
+using namespace std;
+using sched::ll;
+using sched::Status;
+
+// A full key index refuses new keys without probing forever, and reclaim()
+// gives the items of erased and missed keys back, keeping the present ones.
+
+bool ok = true;
+
+void check(bool cond, const char* name, const char* what) {
+    if (!cond) {
+        printf("FAILED (%s): %s\n", name, what);
+        ok = false;
+    }
+}
+
+template <typename S>
+void run(const char* name) {
+    sched::Keyed<S> keyed(2); // Four items
+    ll val;
+
+    // Fill the index: two present keys, one erased, one only read
+    auto* t = keyed.begin();
+    check(keyed.write(t, 10, 1) && keyed.write(t, 20, 2), name, "writes of new keys");
+    check(keyed.write(t, 30, 3) && keyed.erase(t, 30), name, "erase of a new key");
+    check(keyed.read(t, 40, val) && val == keyed.ABSENT, name, "read of a missing key");
+    check(keyed.commit(t) == Status::COMMIT, name, "commit");
+    delete t;
+
+    t = keyed.begin();
+    check(!keyed.write(t, 50, 5), name, "a new key is refused once the index is full");
+    check(!keyed.read(t, 50, val), name, "a read of a new key is refused too");
+    check(keyed.read(t, 10, val) && val == 1, name, "keys in the index stay usable");
+    keyed.abort(t);
+    delete t;
+
+    check(keyed.reclaim(), name, "reclaim");
+    check(!keyed.known(30) && !keyed.known(40), name, "absent keys leave the index");
+
+    t = keyed.begin();
+    check(keyed.write(t, 50, 5), name, "a new key fits after reclaim");
+    check(keyed.read(t, 10, val) && val == 1, name, "present keys keep their values");
+    check(keyed.read(t, 20, val) && val == 2, name, "present keys keep their values");
+    check(keyed.commit(t) == Status::COMMIT, name, "commit after reclaim");
+    delete t;
+}
+
+int main() {
+    run<sched::O2PL<>>("O2PL");
+    run<sched::SS2PL<>>("SS2PL");
+    run<sched::BOCC<>>("BOCC");
+    run<sched::FOCC_CTA<>>("FOCC");
+
+    printf(ok ? "All checks passed\n" : "Some checks failed\n");
+    return ok ? 0 : 1;
+}
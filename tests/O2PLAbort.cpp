@@ -0,0 +1,101 @@
+#include <bits/stdc++.h>
+#include "../lib/O2PL.h"
+using namespace std;
+using sched::ll;
+using sched::Status;
+
+// Aborts under O2PL must cascade to the transactions that followed the
+// aborted writes, and leave the items as they were before those writes, in
+// whichever order the transactions abort.
+
+using O2PL = sched::O2PL<>;
+
+bool ok = true;
+
+void check(bool cond, const char* what) {
+    if (!cond) {
+        printf("FAILED: %s\n", what);
+        ok = false;
+    }
+}
+
+int main() {
+    {
+        // T1 writes, T2 reads the write, T1 aborts: T2 must abort
+        O2PL o2pl(1);
+        auto* t1 = o2pl.begin();
+        auto* t2 = o2pl.begin();
+        ll val = 0;
+        o2pl.write(t1, 0, 5);
+        o2pl.read(t2, 0, val);
+        check(val == 5, "T2 reads T1's write");
+        o2pl.abort(t1);
+        check(o2pl.commit(t2) == Status::ABORT, "T2 aborts after T1");
+        check(o2pl.cascaded(t2), "T2's abort is reported as cascaded");
+        check(o2pl.value(0) == 0, "the item is restored");
+        delete t1;
+        delete t2;
+
+        // A transaction begun after the aborts is not affected
+        auto* t3 = o2pl.begin();
+        o2pl.read(t3, 0, val);
+        o2pl.write(t3, 0, val + 1);
+        check(o2pl.commit(t3) == Status::COMMIT, "a later transaction commits");
+        check(o2pl.value(0) == 1, "the later transaction's write stays");
+        delete t3;
+    }
+
+    {
+        // The same with a read-only reader
+        O2PL o2pl(1);
+        auto* t1 = o2pl.begin();
+        auto* t2 = o2pl.beginReadOnly();
+        ll val = 0;
+        o2pl.write(t1, 0, 5);
+        o2pl.read(t2, 0, val);
+        o2pl.abort(t1);
+        check(o2pl.commit(t2) == Status::ABORT, "a read-only reader aborts after the writer");
+        delete t1;
+        delete t2;
+    }
+
+    // T1 writes, T2 overwrites it: whichever aborts first, the item ends up as
+    // it was before T1
+    for (bool t1First : {true, false}) {
+        O2PL o2pl(1);
+        o2pl.setValue(0, 7);
+        auto* t1 = o2pl.begin();
+        auto* t2 = o2pl.begin();
+        o2pl.write(t1, 0, 5);
+        o2pl.write(t2, 0, 6);
+        if (t1First) {
+            o2pl.abort(t1);
+            check(o2pl.commit(t2) == Status::ABORT, "an overwriting transaction aborts after the first writer");
+        }
+        else {
+            o2pl.abort(t2);
+            o2pl.abort(t1);
+        }
+        check(o2pl.value(0) == 7, t1First ? "restored when the first writer aborts first"
+                                          : "restored when the last writer aborts first");
+        delete t1;
+        delete t2;
+    }
+
+    {
+        // A transaction ordered before the aborted write commits
+        O2PL o2pl(1);
+        auto* t1 = o2pl.begin();
+        auto* t2 = o2pl.begin();
+        ll val = 0;
+        o2pl.read(t1, 0, val);
+        o2pl.write(t2, 0, 5);
+        o2pl.abort(t2);
+        check(o2pl.commit(t1) == Status::COMMIT, "an earlier reader commits");
+        delete t1;
+        delete t2;
+    }
+
+    printf(ok ? "All checks passed\n" : "Some checks failed\n");
+    return ok ? 0 : 1;
+}